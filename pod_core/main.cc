@@ -77,6 +77,8 @@ int main(int argc, char** argv) {
   bool test_evil = false;
   bool dump_ecc_pub = false;
   uint32_t thread_num = 0;
+  int64_t vrs_cache_check = 0;
+  int64_t vrs_memory_budget = 0;
 
   try {
     po::options_description options("command line options");
@@ -108,6 +110,14 @@ int main(int argc, char** argv) {
         "phantoms_a phantoms_b phantoms_c)")(
         "thread_num", po::value<uint32_t>(&thread_num),
         "Provide the number of the parallel threads, 1: disable, 0: default.")(
+        "vrs_cache_check",
+        po::value<int64_t>(&vrs_cache_check)->default_value(0),
+        "Provide the number of the vrs cache chunks to recompute when a cache "
+        "is used, 0: only check the mac")(
+        "vrs_memory_budget",
+        po::value<int64_t>(&vrs_memory_budget)->default_value(0),
+        "Provide the memory budget(MB) of the vrs chunks in flight when "
+        "alice proves, 0: default")(
         "use_c_api,c", "")("test_evil", "")("dump_ecc_pub", "");
 
     boost::program_options::variables_map vmap;
@@ -140,6 +150,10 @@ int main(int argc, char** argv) {
   }
 
   setenv("options:data_dir", data_dir.c_str(), true);
+  setenv("options:vrs_cache_check", std::to_string(vrs_cache_check).c_str(),
+         true);
+  setenv("options:vrs_memory_budget",
+         std::to_string(vrs_memory_budget).c_str(), true);
 
 #ifdef USE_TBB
   int tbb_thread_num =
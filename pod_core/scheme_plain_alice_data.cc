@@ -12,7 +12,6 @@ AliceData::AliceData(std::string const& publish_path)
   std::string public_path = publish_path_ + "/public";
   std::string private_path = publish_path_ + "/private";
   std::string bulletin_file = publish_path_ + "/bulletin";
-  std::string sigma_file = public_path + "/sigma";
   std::string sigma_mkl_tree_file = public_path + "/sigma_mkl_tree";
   std::string matrix_file = private_path + "/matrix";
 
@@ -22,7 +21,7 @@ AliceData::AliceData(std::string const& publish_path)
   }
 
   // sigma
-  if (!LoadSigma(sigma_file, bulletin_.n, nullptr, sigmas_)) {
+  if (!LoadSigmaAny(public_path, bulletin_.n, nullptr, sigmas_)) {
     assert(false);
     throw std::runtime_error("invalid sigma file");
   }
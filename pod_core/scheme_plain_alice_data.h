@@ -23,7 +23,7 @@ class AliceData {
   std::string const publish_path_;
   scheme::plain::Bulletin bulletin_;
   std::vector<G1> sigmas_;
-  mkl::Tree sigma_mkl_tree_;
+  mkl::TreeView sigma_mkl_tree_;
   std::vector<Fr> m_;  // secret
 };
 
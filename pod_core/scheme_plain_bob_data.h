@@ -16,7 +16,9 @@ class BobData {
   BobData(Bulletin const& bulletin, std::string const& public_path);
   BobData(std::string const& bulletin_file, std::string const& public_path);
   Bulletin const& bulletin() const { return bulletin_; }
-  std::vector<G1> sigmas() const { return sigmas_; }
+  // sigmas of the demands, in the order of demands
+  bool GetSigmas(std::vector<Range> const& demands,
+                 std::vector<G1>& sigmas) const;
   bool SaveDecryped(std::string const& file, std::vector<Range> const& demands,
                     std::vector<Fr> const& decrypted);
 
@@ -29,7 +31,7 @@ class BobData {
   std::string public_path_;
 
  private:
-  std::vector<G1> sigmas_;
+  std::vector<G1> sigmas_;  // empty in demand mode
 };
 
 typedef std::shared_ptr<BobData> BobDataPtr;
@@ -13,7 +13,6 @@ AliceData::AliceData(std::string const& publish_path)
   std::string private_path = publish_path_ + "/private";
   std::string matrix_file = private_path + "/matrix";
   std::string bulletin_file = publish_path_ + "/bulletin";
-  std::string sigma_file = public_path + "/sigma";
   std::string sigma_mkl_tree_file = public_path + "/sigma_mkl_tree";
   std::string vrf_pk_file = public_path + "/vrf_pk";
   std::string vrf_sk_file = private_path + "/vrf_sk";
@@ -65,7 +64,7 @@ AliceData::AliceData(std::string const& publish_path)
   }
 
   // sigma
-  if (!LoadSigma(sigma_file, bulletin_.n, nullptr, sigmas_)) {
+  if (!LoadSigmaAny(public_path, bulletin_.n, nullptr, sigmas_)) {
     assert(false);
     throw std::runtime_error("invalid sigma file");
   }
@@ -36,7 +36,7 @@ class AliceData {
   VrfMeta vrf_meta_;
   std::vector<bp::P1Proof> vrf_key_bp_proofs_;
   std::vector<G1> sigmas_;
-  mkl::Tree sigma_mkl_tree_;
+  mkl::TreeView sigma_mkl_tree_;
   std::vector<Fr> m_;  // secret
   std::vector<std::vector<Fr>> key_m_;
 };
@@ -45,7 +45,6 @@ void BobData::LoadData() {
     throw std::runtime_error("Bob: invalid bulletin");
 
   std::string verify_file = public_path_ + "/.verify";
-  std::string sigma_file = public_path_ + "/sigma";
   std::string sigma_mkl_tree_file = public_path_ + "/sigma_mkl_tree";
   std::string vrf_pk_file = public_path_ + "/vrf_pk";
   std::string key_meta_file = public_path_ + "/vrf_meta";
@@ -73,14 +72,16 @@ void BobData::LoadData() {
     }
   }
 
-  // sigma
-  check_h = verify ? &bulletin_.sigma_mkl_root : nullptr;
-  if (!LoadSigma(sigma_file, bulletin_.n, check_h, sigmas_)) {
-    assert(false);
-    throw std::runtime_error("invalid sigma file");
+  // vrf bp, need all the sigmas. Otherwise use demand mode if possible,
+  // GetSigmas() loads and verifies the demanded rows.
+  if (verify || !fs::is_regular_file(sigma_mkl_tree_file)) {
+    check_h = verify ? &bulletin_.sigma_mkl_root : nullptr;
+    if (!LoadSigmaAny(public_path_, bulletin_.n, check_h, sigmas_)) {
+      assert(false);
+      throw std::runtime_error("invalid sigma file");
+    }
   }
 
-  // vrf bp
   if (verify) {
     for (size_t j = 0; j < vrf_meta_.keys.size(); ++j) {
       auto key_bp_file = public_path_ + "/key_bp_" + std::to_string(j);
@@ -105,6 +106,22 @@ void BobData::LoadData() {
   }
 }
 
+bool BobData::GetSigmas(std::vector<Range> const& demands,
+                        std::vector<G1>& sigmas) const {
+  if (sigmas_.empty()) {
+    return LoadSigmaRanges(public_path_, bulletin_.n, bulletin_.sigma_mkl_root,
+                           demands, sigmas);
+  }
+
+  sigmas.clear();
+  for (auto const& demand : demands) {
+    if (demand.start + demand.count > sigmas_.size()) return false;
+    sigmas.insert(sigmas.end(), sigmas_.begin() + demand.start,
+                  sigmas_.begin() + demand.start + demand.count);
+  }
+  return true;
+}
+
 bool BobData::SaveDecryped(std::string const& file,
                            std::vector<Range> const& demands,
                            std::vector<Fr> const& decrypted) {
@@ -21,7 +21,9 @@ class BobData {
   Bulletin const& bulletin() const { return bulletin_; }
   vrf::Pk<> const& vrf_pk() const { return vrf_pk_; }
   VrfMeta const& vrf_meta() const { return vrf_meta_; }
-  std::vector<G1> sigmas() const { return sigmas_; }
+  // sigmas of the demands, in the order of demands
+  bool GetSigmas(std::vector<Range> const& demands,
+                 std::vector<G1>& sigmas) const;
   std::vector<std::vector<Fr>> const& key_m() const { return key_m_; }
   bool SaveDecryped(std::string const& file, std::vector<Range> const& demands,
                     std::vector<Fr> const& decrypted);
@@ -37,7 +39,7 @@ class BobData {
  private:
   VrfMeta vrf_meta_;
   vrf::Pk<> vrf_pk_;
-  std::vector<G1> sigmas_;
+  std::vector<G1> sigmas_;  // empty in demand mode
   std::vector<std::vector<Fr>> key_m_;
 };
 
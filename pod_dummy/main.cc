@@ -10,6 +10,7 @@
 #include "groth09/groth09.h"
 #include "hyrax/hyrax.h"
 #include "misc.h"
+#include "mkl_tree.h"
 #include "public.h"
 #include "tick.h"
 #include "groth09/test.h"
@@ -46,7 +47,12 @@ int main(int argc, char** argv) {
   groth09::Test();
   //vrs::Test();
   //vrs::TestLarge();
+  //vrs::TestLargeBatch();
+  //vrs::TestCacheStore();
+  //vrs::TestCacheFile();
   //vrs::TestCache();
+  //mkl::TestMultiProof(1000);
+  //mkl::TestExtendTree(1000, 999, 1100);
   //hyrax::a1::TestRom();
   //gkr_main(argc, argv);
   return 0;
@@ -23,6 +23,10 @@ int main(int argc, char** argv) {
   uint64_t column_num;
   std::string data_dir;
   uint32_t thread_num = 0;
+  uint64_t memory_budget = 0;
+  bool convert_sigma = false;
+  std::string append_dir;
+  std::string convert_table;
 
   try {
     po::options_description options("command line options");
@@ -31,6 +35,12 @@ int main(int argc, char** argv) {
         "publish table file")(
         "-d data_dir -m plain -f file -o output_dir -c column_num",
         "publish plain file")(
+        "-d data_dir -f file -o output_dir --append old_output_dir",
+        "publish the grown file of an existing publish to a new dir")(
+        "-f csv_file --convert_table bin_file",
+        "convert a csv file to the bin table (publish it with -t bin)")(
+        "-d data_dir -o output_dir --convert_sigma",
+        "convert the sigma of an existing publish to the affine format")(
         "data_dir,d", po::value<std::string>(&data_dir)->default_value("."),
         "Provide the configure file dir")(
         "mode,m", po::value<Mode>(&task_mode)->default_value(Mode::kPlain),
@@ -41,7 +51,7 @@ int main(int argc, char** argv) {
         "output_dir,o", po::value<std::string>(&output_dir)->default_value(""),
         "Provide the publish path")(
         "table_type,t", po::value<Type>(&table_type)->default_value(Type::kCsv),
-        "Provide the publish file type in table mode (csv)")(
+        "Provide the publish file type in table mode (csv, bin)")(
         "column_num,c", po::value<uint64_t>(&column_num)->default_value(1023),
         "Provide the column number per block(line) in "
         "plain mode (default 1023)")(
@@ -53,7 +63,18 @@ int main(int argc, char** argv) {
         "Provide the flag if publish must unique the key"
         " in table mode (for example: -u 1 0 1)")(
         "thread_num", po::value<uint32_t>(&thread_num)->default_value(0),
-        "Provide the number of the parallel thread, 1: disable, 0: default.");
+        "Provide the number of the parallel thread, 1: disable, 0: default.")(
+        "memory_budget", po::value<uint64_t>(&memory_budget)->default_value(0),
+        "Provide the memory budget(MB) of the streaming publish in plain "
+        "mode, 0: load the whole file (default 0)")(
+        "append", po::value<std::string>(&append_dir)->default_value(""),
+        "Provide the existing publish dir, the file must start with its "
+        "data. The mode and columns are taken from it")(
+        "convert_table",
+        po::value<std::string>(&convert_table)->default_value(""),
+        "Convert publish_file from csv to the bin table file")(
+        "convert_sigma",
+        "Convert output_dir/public/sigma to output_dir/public/sigma_affine");
 
     boost::program_options::variables_map vmap;
 
@@ -66,48 +87,78 @@ int main(int argc, char** argv) {
       return -1;
     }
 
-    if (output_dir.empty()) {
-      std::cout << "Want output_dir(-o)\n";
-      std::cout << options << std::endl;
-      return -1;
-    }
-
-    if (publish_file.empty() || !fs::is_regular(publish_file)) {
-      std::cout << "Open publish_file " << publish_file << " failed\n";
-      std::cout << options << std::endl;
-      return -1;
+    if (!convert_table.empty()) {
+      if (publish_file.empty() || !fs::is_regular(publish_file)) {
+        std::cout << "Open publish_file " << publish_file << " failed\n";
+        std::cout << options << std::endl;
+        return -1;
+      }
+      return ConvertTable(std::move(publish_file), std::move(convert_table))
+                 ? 0
+                 : -1;
     }
 
-    if (fs::file_size(publish_file) == 0) {
-      std::cout << "The file size of " << publish_file << " is 0\n";
+    if (output_dir.empty()) {
+      std::cout << "Want output_dir(-o)\n";
       std::cout << options << std::endl;
       return -1;
     }
 
-    if (!fs::is_directory(output_dir) && !fs::create_directories(output_dir)) {
-      std::cout << "Create " << output_dir << " failed\n";
-      std::cout << options << std::endl;
-      return -1;
+    if (vmap.count("convert_sigma")) {
+      convert_sigma = true;
     }
 
-    if (task_mode == Mode::kPlain) {
-      if (column_num == 0) {
-        std::cout << "column_num can not be 0.\n";
+    if (convert_sigma) {
+      if (!fs::is_directory(output_dir)) {
+        std::cout << "Open output_dir " << output_dir << " failed\n";
         std::cout << options << std::endl;
         return -1;
       }
     } else {
-      std::sort(vrf_colnum_index.begin(), vrf_colnum_index.end());
-      vrf_colnum_index.erase(
-          std::unique(vrf_colnum_index.begin(), vrf_colnum_index.end()),
-          vrf_colnum_index.end());
+      if (publish_file.empty() || !fs::is_regular(publish_file)) {
+        std::cout << "Open publish_file " << publish_file << " failed\n";
+        std::cout << options << std::endl;
+        return -1;
+      }
+
+      if (fs::file_size(publish_file) == 0) {
+        std::cout << "The file size of " << publish_file << " is 0\n";
+        std::cout << options << std::endl;
+        return -1;
+      }
 
-      if (vrf_colnum_index.empty()) {
-        std::cout << "Want vrf_colnum_index in table mode.\n";
+      if (!fs::is_directory(output_dir) &&
+          !fs::create_directories(output_dir)) {
+        std::cout << "Create " << output_dir << " failed\n";
         std::cout << options << std::endl;
         return -1;
       }
-      unique_key.resize(vrf_colnum_index.size());
+
+      if (!append_dir.empty()) {
+        if (!scheme::GetBulletinMode(append_dir + "/bulletin", task_mode)) {
+          std::cout << "Open the bulletin of " << append_dir << " failed\n";
+          std::cout << options << std::endl;
+          return -1;
+        }
+      } else if (task_mode == Mode::kPlain) {
+        if (column_num == 0) {
+          std::cout << "column_num can not be 0.\n";
+          std::cout << options << std::endl;
+          return -1;
+        }
+      } else {
+        std::sort(vrf_colnum_index.begin(), vrf_colnum_index.end());
+        vrf_colnum_index.erase(
+            std::unique(vrf_colnum_index.begin(), vrf_colnum_index.end()),
+            vrf_colnum_index.end());
+
+        if (vrf_colnum_index.empty()) {
+          std::cout << "Want vrf_colnum_index in table mode.\n";
+          std::cout << options << std::endl;
+          return -1;
+        }
+        unique_key.resize(vrf_colnum_index.size());
+      }
     }
   } catch (std::exception& e) {
     std::cout << "Unknown parameters.\n"
@@ -140,20 +191,33 @@ int main(int argc, char** argv) {
   }
 
   bool ret;
-  switch (task_mode) {
-    case Mode::kPlain: {
-      ret = PublishPlain(std::move(publish_file), std::move(output_dir),
-                         column_num);
-      break;
+  if (convert_sigma) {
+    ret = ConvertSigma(std::move(output_dir));
+  } else if (!append_dir.empty()) {
+    if (task_mode == Mode::kPlain) {
+      ret = PublishPlainAppend(std::move(publish_file), std::move(output_dir),
+                               std::move(append_dir),
+                               memory_budget * 1024 * 1024);
+    } else {
+      ret = PublishTableAppend(std::move(publish_file), std::move(output_dir),
+                               std::move(append_dir), table_type);
     }
-    case Mode::kTable: {
-      ret = PublishTable(std::move(publish_file), std::move(output_dir),
-                         std::move(table_type), std::move(vrf_colnum_index),
-                         std::move(unique_key));
-      break;
+  } else {
+    switch (task_mode) {
+      case Mode::kPlain: {
+        ret = PublishPlain(std::move(publish_file), std::move(output_dir),
+                           column_num, memory_budget * 1024 * 1024);
+        break;
+      }
+      case Mode::kTable: {
+        ret = PublishTable(std::move(publish_file), std::move(output_dir),
+                           std::move(table_type), std::move(vrf_colnum_index),
+                           std::move(unique_key));
+        break;
+      }
+      default:
+        throw std::runtime_error("never reach");
     }
-    default:
-      throw std::runtime_error("never reach");
   }
 
   if (ret) {
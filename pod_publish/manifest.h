@@ -0,0 +1,171 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "misc.h"
+#include "parallel.h"
+#include "public.h"
+
+// Records the finished stages of a publish into output_path/manifest, so a
+// failed publish can be run again and skip them. A stage is done only if the
+// sha256 of its files are unchanged. The stages are ordered, redoing a stage
+// drops the later ones.
+class PublishManifest {
+ public:
+  // inputs: the digest of the publish file and the arguments, the stages
+  // recorded for other inputs are dropped
+  bool Open(std::string const& file, std::string const& inputs) {
+    file_ = file;
+    inputs_ = inputs;
+    stages_.clear();
+
+    boost::system::error_code err;
+    if (!fs::is_regular_file(file_, err)) return Save();
+
+    try {
+      pt::ptree tree;
+      pt::read_json(file_, tree);
+      if (tree.get<std::string>("inputs") != inputs_) {
+        std::cout << "publish inputs changed, start over\n";
+        return Save();
+      }
+      for (auto& stage_node : tree.get_child("stages")) {
+        Stage stage;
+        stage.name = stage_node.second.get<std::string>("name");
+        for (auto& file_node : stage_node.second.get_child("files")) {
+          h256_t digest;
+          misc::HexStrToH256(file_node.second.get<std::string>("digest"),
+                             digest);
+          stage.files.emplace_back(file_node.second.get<std::string>("path"),
+                                   digest);
+        }
+        for (auto& value_node : stage_node.second.get_child("values")) {
+          stage.values[value_node.first] = value_node.second.data();
+        }
+        stages_.emplace_back(std::move(stage));
+      }
+      return true;
+    } catch (std::exception&) {
+      std::cout << "invalid manifest, start over\n";
+      stages_.clear();
+      return Save();
+    }
+  }
+
+  // if the stage is not done, it and the later stages are dropped
+  bool IsDone(std::string const& name) {
+    auto it = Find(name);
+    if (it != stages_.end() && IsValid(*it)) {
+      std::cout << "skip the finished stage: " << name << "\n";
+      return true;
+    }
+    if (it != stages_.end()) {
+      stages_.erase(it, stages_.end());
+      Save();
+    }
+    return false;
+  }
+
+  bool Done(std::string const& name, std::vector<std::string> const& files,
+            std::map<std::string, std::string> values = {}) {
+    auto it = Find(name);
+    if (it != stages_.end()) stages_.erase(it, stages_.end());
+
+    Stage stage;
+    stage.name = name;
+    stage.files.resize(files.size());
+    std::vector<uint8_t> ok(files.size());
+    auto parallel_f = [&files, &stage, &ok](int64_t i) {
+      stage.files[i].first = files[i];
+      ok[i] = misc::GetFileSha256(files[i], stage.files[i].second);
+    };
+    parallel::For((int64_t)files.size(), parallel_f);
+    if (std::count(ok.begin(), ok.end(), 0)) return false;
+
+    stage.values = std::move(values);
+    stages_.emplace_back(std::move(stage));
+    return Save();
+  }
+
+  bool GetValue(std::string const& name, std::string const& key,
+                std::string& value) const {
+    auto it = std::find_if(
+        stages_.begin(), stages_.end(),
+        [&name](Stage const& stage) { return stage.name == name; });
+    if (it == stages_.end()) return false;
+    auto it_value = it->values.find(key);
+    if (it_value == it->values.end()) return false;
+    value = it_value->second;
+    return true;
+  }
+
+ private:
+  struct Stage {
+    std::string name;
+    std::vector<std::pair<std::string, h256_t>> files;
+    std::map<std::string, std::string> values;
+  };
+
+  std::vector<Stage>::iterator Find(std::string const& name) {
+    return std::find_if(
+        stages_.begin(), stages_.end(),
+        [&name](Stage const& stage) { return stage.name == name; });
+  }
+
+  static bool IsValid(Stage const& stage) {
+    std::vector<uint8_t> ok(stage.files.size());
+    auto parallel_f = [&stage, &ok](int64_t i) {
+      auto const& file = stage.files[i];
+      h256_t digest;
+      ok[i] = misc::GetFileSha256(file.first, digest) && digest == file.second;
+    };
+    parallel::For((int64_t)stage.files.size(), parallel_f);
+    return std::count(ok.begin(), ok.end(), 0) == 0;
+  }
+
+  // write a temp file and rename it, the manifest is never half written
+  bool Save() const {
+    try {
+      pt::ptree tree;
+      tree.put("inputs", inputs_);
+      pt::ptree stages_node;
+      for (auto const& stage : stages_) {
+        pt::ptree stage_node;
+        stage_node.put("name", stage.name);
+        pt::ptree files_node;
+        for (auto const& file : stage.files) {
+          pt::ptree file_node;
+          file_node.put("path", file.first);
+          file_node.put("digest", misc::HexToStr(file.second));
+          files_node.push_back(std::make_pair("", file_node));
+        }
+        stage_node.add_child("files", files_node);
+        pt::ptree values_node;
+        for (auto const& value : stage.values) {
+          values_node.push_back(
+              std::make_pair(value.first, pt::ptree(value.second)));
+        }
+        stage_node.add_child("values", values_node);
+        stages_node.push_back(std::make_pair("", stage_node));
+      }
+      tree.add_child("stages", stages_node);
+
+      std::string temp_file = file_ + ".tmp";
+      pt::write_json(temp_file, tree);
+      fs::rename(temp_file, file_);
+      return true;
+    } catch (std::exception&) {
+      assert(false);
+      return false;
+    }
+  }
+
+  std::string file_;
+  std::string inputs_;
+  std::vector<Stage> stages_;
+};
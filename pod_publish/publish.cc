@@ -4,9 +4,9 @@
 #include "bulletin_plain.h"
 #include "bulletin_table.h"
 #include "chain.h"
-#include "csv.hpp"
 #include "ecc.h"
 #include "ecc_pub.h"
+#include "manifest.h"
 #include "misc.h"
 #include "mkl_tree.h"
 #include "multiexp.h"
@@ -14,51 +14,147 @@
 #include "scheme_misc.h"
 #include "scheme_plain.h"
 #include "scheme_table.h"
+#include "table_bin.h"
+#include "table_csv.h"
 #include "vrf_meta.h"
 
 namespace {
 
 using namespace scheme;
-bool LoadCsvTable(std::string const& file, std::vector<std::string>& col_names,
-                  table::Table& table) {
+bool LoadTable(std::string const& file, table::Type table_type,
+               std::vector<std::string>& col_names, table::TableView& table) {
+  switch (table_type) {
+    case table::Type::kCsv:
+      return table::LoadCsv(file, col_names, table);
+    case table::Type::kBin:
+      return table::LoadBinTable(file, col_names, table);
+    default:
+      // TBD: support more db file types
+      return false;
+  }
+}
+
+void PadRubbishRow(table::TableView& table) {
   Tick _tick_(__FUNCTION__);
-  using namespace csv;
-  try {
-    CSVReader reader(file);
-    col_names = reader.get_col_names();
-
-    for (CSVRow& row : reader) {  // Input iterator
-      table::Record record;
-      for (CSVField& field : row) {
-        record.push_back(std::string(field.get<>()));
-      }
-      assert(record.size() == col_names.size());
-      table.emplace_back(std::move(record));
+  table.fields.insert(table.fields.end(), table.col_num,
+                      std::string_view("PAD"));
+}
+
+// key_m and mj_mkl_root of every vrf key
+bool BuildKeyM(table::Bulletin const& bulletin, std::vector<Fr> const& m,
+               std::vector<std::string> const& key_m_files,
+               table::VrfMeta& vrf_meta) {
+  using namespace scheme::table;
+  using namespace misc;
+
+  for (size_t j = 0; j < vrf_meta.keys.size(); ++j) {
+    std::vector<Fr> km(bulletin.n);
+    for (size_t i = 0; i < bulletin.n; ++i) {
+      km[i] = m[i * bulletin.s + j];
     }
-    reader.close();
-    return true;
-  } catch (std::exception& e) {
-    std::cerr << e.what() << std::endl;
-    return false;
+
+    // NOTE: After UniqueRecords(), all of the keys are difference. But there
+    // still has very small probability that the km is not unique (two
+    // difference key have same digest).
+    // Here just simply not supporting such data.
+    if (vrf_meta.keys[j].unique && !IsElementUnique(km)) {
+      assert(false);
+      return false;
+    }
+
+    // save key_m_files
+    if (!SaveMatrix(key_m_files[j], km)) {
+      assert(false);
+      return false;
+    }
+
+    auto get_item = [&km](uint64_t i) -> h256_t {
+      if (i < km.size()) {
+        h256_t h;
+        FrToBin(km[i], h.data());
+        return h;
+      } else {
+        return h256_t();
+      }
+    };
+    vrf_meta.keys[j].mj_mkl_root =
+        mkl::ParallelCalcRoot(get_item, bulletin.n);
   }
+  return true;
 }
 
-bool LoadTable(std::string const& file, table::Type table_type,
-               std::vector<std::string>& col_names, table::Table& table) {
-  if (table_type != table::Type::kCsv) {
-    // TBD: support more db file types
-    return false;
+// the key bp proof of every vrf key
+bool BuildKeyBpFiles(table::Bulletin const& bulletin, std::vector<Fr> const& m,
+                     std::vector<G1> const& sigmas,
+                     std::vector<std::string> const& key_bp_files,
+                     table::VrfMeta& vrf_meta) {
+  using namespace scheme::table;
+  using namespace misc;
+
+  // key bp proof: bp about relation about mi_key with sigma_i. The key i is
+  // the column i of m, which is what the verifier uses.
+  std::vector<uint64_t> key_pos(vrf_meta.keys.size());
+  std::vector<h256_t> key_roots(vrf_meta.keys.size());
+  for (size_t i = 0; i < vrf_meta.keys.size(); ++i) {
+    key_pos[i] = i;
+    key_roots[i] = vrf_meta.keys[i].mj_mkl_root;
   }
-  return LoadCsvTable(file, col_names, table);
-}
+  std::vector<bp::P1Proof> bp_p1_proofs;
+  BuildKeyBps(bulletin.n, bulletin.s, m, bulletin.sigma_mkl_root, key_pos,
+              key_roots, bp_p1_proofs);
 
-void PadRubbishRow(table::Table& table) {
-  Tick _tick_(__FUNCTION__);
-  table::Record record(table[0].size());
-  for (auto& i : record) {
-    i = "PAD";
+  for (size_t i = 0; i < vrf_meta.keys.size(); ++i) {
+    auto& key = vrf_meta.keys[i];
+    auto const& bp_p1_proof = bp_p1_proofs[i];
+
+#ifdef _DEBUG
+    std::vector<Fr> dummy_km(bulletin.n);
+    for (uint64_t col = 0; col < bulletin.n; ++col) {
+      dummy_km[col] = m[col * bulletin.s + i];
+    }
+    assert(VerifyKeyBp(bulletin.n, bulletin.s, dummy_km, sigmas, i,
+                       bulletin.sigma_mkl_root, key.mj_mkl_root,
+                       bp_p1_proof));
+#endif
+
+    if (!SaveBpP1Proof(key_bp_files[i], bp_p1_proof)) {
+      assert(false);
+      return false;
+    }
+    if (!GetFileSha256(key_bp_files[i], key.bp_digest)) {
+      assert(false);
+      return false;
+    }
   }
-  table.emplace_back(std::move(record));
+
+  return true;
+}
+
+// key_m, mj_mkl_root and the key bp proof of every vrf key
+bool BuildKeys(table::Bulletin const& bulletin, std::vector<Fr> const& m,
+               std::vector<G1> const& sigmas,
+               std::vector<std::string> const& key_m_files,
+               std::vector<std::string> const& key_bp_files,
+               table::VrfMeta& vrf_meta) {
+  return BuildKeyM(bulletin, m, key_m_files, vrf_meta) &&
+         BuildKeyBpFiles(bulletin, m, sigmas, key_bp_files, vrf_meta);
+}
+
+// the digest of the publish file and the arguments which change the output
+bool GetPublishInputs(std::string const& publish_file, std::string const& args,
+                      std::string& inputs) {
+  h256_t digest;
+  if (!misc::GetFileSha256(publish_file, digest)) return false;
+  inputs = args + ";file=" + misc::HexToStr(digest);
+  return true;
+}
+
+template <typename T>
+std::string JoinArgs(std::vector<T> const& v) {
+  std::string ret;
+  for (auto const& i : v) ret += std::to_string(i) + ",";
+  if (!ret.empty()) ret.pop_back();
+  return ret;
 }
 }  // namespace
 
@@ -103,23 +199,54 @@ bool PublishTable(std::string publish_file, std::string output_path,
     key_m_files[i] = public_path + "/key_m_" + str_i;
   }
 
-  if (!CopyData(publish_file, original_file)) {
+  std::string args = "mode=table;type=" + std::to_string(table_type) +
+                     ";keys=" + JoinArgs(vrf_colnums_index) +
+                     ";unique=" + JoinArgs(unique_key);
+  std::string inputs;
+  PublishManifest manifest;
+  if (!GetPublishInputs(publish_file, args, inputs) ||
+      !manifest.Open(output_path + "/manifest", inputs)) {
     assert(false);
     return false;
   }
 
-  vrf::Pk<> vrf_pk;
-  vrf::Sk<> vrf_sk;
+  if (!manifest.IsDone("original")) {
+    if (!CopyData(publish_file, original_file) ||
+        !manifest.Done("original", {original_file})) {
+      assert(false);
+      return false;
+    }
+  }
 
-  vrf::Generate<>(vrf_pk, vrf_sk);
+  // the matrix depends on vrf_sk, so the key pair is saved first
+  vrf::Sk<> vrf_sk;
+  if (manifest.IsDone("vrf_key")) {
+    if (!LoadVrfSk(vrf_sk_file, vrf_sk)) {
+      assert(false);
+      return false;
+    }
+  } else {
+    vrf::Pk<> vrf_pk;
+    vrf::Generate<>(vrf_pk, vrf_sk);
+    if (!SaveVrfPk(vrf_pk_file, vrf_pk) || !SaveVrfSk(vrf_sk_file, vrf_sk) ||
+        !manifest.Done("vrf_key", {vrf_pk_file, vrf_sk_file})) {
+      assert(false);
+      return false;
+    }
+  }
 
-  Table table;
+  TableView table;
   VrfMeta vrf_meta;
   if (!LoadTable(original_file, table_type, vrf_meta.column_names, table)) {
     assert(false);
     return false;
   }
 
+  if (!GetFileSha256(vrf_pk_file, vrf_meta.pk_digest)) {
+    assert(false);
+    return false;
+  }
+
   vrf_meta.keys.resize(vrf_colnums_index.size());
   for (uint64_t i = 0; i < vrf_colnums_index.size(); ++i) {
     vrf_meta.keys[i].column_index = vrf_colnums_index[i];
@@ -147,101 +274,90 @@ bool PublishTable(std::string publish_file, std::string output_path,
     return false;
   }
 
-  std::vector<Fr> m(bulletin.n * bulletin.s);
-  DataToM(table, vrf_colnums_index, bulletin.s, vrf_sk, m);
-  if (!SaveMatrix(matrix_file, m)) {
-    assert(false);
-    return false;
+  std::vector<Fr> m;
+  if (manifest.IsDone("matrix")) {
+    if (!LoadMatrix(matrix_file, bulletin.n * bulletin.s, m)) {
+      assert(false);
+      return false;
+    }
+  } else {
+    m.resize(bulletin.n * bulletin.s);
+    DataToM(table, vrf_colnums_index, bulletin.s, vrf_sk, m);
+    if (!SaveMatrix(matrix_file, m) ||
+        !manifest.Done("matrix", {matrix_file})) {
+      assert(false);
+      return false;
+    }
   }
 
   // sigma
-  std::vector<G1> sigmas = CalcSigma(m, bulletin.n, bulletin.s);
-  if (!SaveSigma(sigma_file, sigmas)) {
-    assert(false);
-    return false;
+  std::vector<G1> sigmas;
+  if (manifest.IsDone("sigma")) {
+    if (!LoadSigma(sigma_file, bulletin.n, nullptr, sigmas)) {
+      assert(false);
+      return false;
+    }
+  } else {
+    sigmas = CalcSigma(m, bulletin.n, bulletin.s);
+    if (!SaveSigma(sigma_file, sigmas) ||
+        !manifest.Done("sigma", {sigma_file})) {
+      assert(false);
+      return false;
+    }
   }
 
   // build sigma mkl tree
-  auto sigma_mkl_tree = BuildSigmaMklTree(sigmas);
-  if (!SaveMkl(sigma_mkl_tree_file, sigma_mkl_tree)) {
-    assert(false);
-    return false;
-  }
-  bulletin.sigma_mkl_root = sigma_mkl_tree.back();
-
-  // vrf pk
-  if (!SaveVrfPk(vrf_pk_file, vrf_pk)) {
-    assert(false);
-    return false;
-  }
-
-  if (!GetFileSha256(vrf_pk_file, vrf_meta.pk_digest)) {
-    assert(false);
-    return false;
-  }
-
-  // vrf sk
-  if (!SaveVrfSk(vrf_sk_file, vrf_sk)) {
-    assert(false);
-    return false;
+  std::string value;
+  if (manifest.IsDone("sigma_mkl_tree") &&
+      manifest.GetValue("sigma_mkl_tree", "root", value)) {
+    HexStrToH256(value, bulletin.sigma_mkl_root);
+  } else {
+    if (!BuildSigmaMklTreeFile(sigma_file, bulletin.n, sigma_mkl_tree_file,
+                               &bulletin.sigma_mkl_root) ||
+        !manifest.Done("sigma_mkl_tree", {sigma_mkl_tree_file},
+                       {{"root", HexToStr(bulletin.sigma_mkl_root)}})) {
+      assert(false);
+      return false;
+    }
   }
 
-  // key and mkl_root
-  for (size_t j = 0; j < vrf_colnums_index.size(); ++j) {
-    std::vector<Fr> km(bulletin.n);
-    for (size_t i = 0; i < bulletin.n; ++i) {
-      km[i] = m[i * bulletin.s + j];
+  // key_m and mj_mkl_root
+  if (manifest.IsDone("key_m")) {
+    for (size_t j = 0; j < vrf_meta.keys.size(); ++j) {
+      auto name = "mj_mkl_root_" + std::to_string(j);
+      if (!manifest.GetValue("key_m", name, value)) {
+        assert(false);
+        return false;
+      }
+      HexStrToH256(value, vrf_meta.keys[j].mj_mkl_root);
     }
-
-    // NOTE: After UniqueRecords(), all of the keys are difference. But there
-    // still has very small probability that the km is not unique (two
-    // difference key have same digest).
-    // Here just simply not supporting such data.
-    if (vrf_meta.keys[j].unique && !IsElementUnique(km)) {
+  } else {
+    if (!BuildKeyM(bulletin, m, key_m_files, vrf_meta)) {
       assert(false);
       return false;
     }
-
-    // save key_m_files
-    if (!SaveMatrix(key_m_files[j], km)) {
+    std::map<std::string, std::string> values;
+    for (size_t j = 0; j < vrf_meta.keys.size(); ++j) {
+      auto name = "mj_mkl_root_" + std::to_string(j);
+      values[name] = HexToStr(vrf_meta.keys[j].mj_mkl_root);
+    }
+    if (!manifest.Done("key_m", key_m_files, std::move(values))) {
       assert(false);
       return false;
     }
-
-    auto get_item = [&km](uint64_t i) -> h256_t {
-      if (i < km.size()) {
-        h256_t h;
-        FrToBin(km[i], h.data());
-        return h;
-      } else {
-        return h256_t();
-      }
-    };
-    vrf_meta.keys[j].mj_mkl_root = mkl::CalcRoot(get_item, bulletin.n);
   }
 
-  // key bp proof: bp about relation about mi_key with sigma_i
-  for (size_t i = 0; i < vrf_colnums_index.size(); ++i) {
-    auto& key = vrf_meta.keys[i];
-    bp::P1Proof bp_p1_proof;
-    BuildKeyBp(bulletin.n, bulletin.s, m, bulletin.sigma_mkl_root,
-               key.column_index, key.mj_mkl_root, bp_p1_proof);
-
-#ifdef _DEBUG
-    std::vector<Fr> dummy_km(bulletin.n);
-    for (uint64_t col = 0; col < bulletin.n; ++col) {
-      dummy_km[col] = m[col * bulletin.s + key.column_index];
-    }
-    assert(VerifyKeyBp(bulletin.n, bulletin.s, dummy_km, sigmas,
-                       key.column_index, bulletin.sigma_mkl_root,
-                       key.mj_mkl_root, bp_p1_proof));
-#endif
-
-    if (!SaveBpP1Proof(key_bp_files[i], bp_p1_proof)) {
-      assert(false);
-      return false;
+  // key bp
+  if (manifest.IsDone("key_bp")) {
+    for (size_t j = 0; j < vrf_meta.keys.size(); ++j) {
+      if (!GetFileSha256(key_bp_files[j], vrf_meta.keys[j].bp_digest)) {
+        assert(false);
+        return false;
+      }
     }
-    if (!GetFileSha256(key_bp_files[i], key.bp_digest)) {
+  } else {
+    if (!BuildKeyBpFiles(bulletin, m, sigmas, key_bp_files, vrf_meta) ||
+        !manifest.Done("key_bp", key_bp_files)) {
       assert(false);
       return false;
     }
@@ -273,10 +389,10 @@ bool PublishTable(std::string publish_file, std::string output_path,
     assert(false);
     return false;
   }
-  Table debug_table;
+  TableView debug_table;
   VrfMeta debug_vrf_meta;
-  if (!LoadTable(debug_data_file, table_type, debug_vrf_meta.column_names,
-                 debug_table)) {
+  // DecryptedRangeMToFile() always outputs csv
+  if (!LoadCsv(debug_data_file, debug_vrf_meta.column_names, debug_table)) {
     assert(false);
     return false;
   }
@@ -290,7 +406,7 @@ bool PublishTable(std::string publish_file, std::string output_path,
 }
 
 bool PublishPlain(std::string publish_file, std::string output_path,
-                  uint64_t column_num) {
+                  uint64_t column_num, uint64_t memory_budget) {
   using namespace scheme;
   using namespace scheme::plain;
   using namespace misc;
@@ -328,60 +444,465 @@ bool PublishPlain(std::string publish_file, std::string output_path,
   std::string sigma_file = public_path + "/sigma";
   std::string sigma_mkl_file = public_path + "/sigma_mkl_tree";
 
+  std::string args = "mode=plain;column_num=" + std::to_string(column_num);
+  std::string inputs;
+  PublishManifest manifest;
+  if (!GetPublishInputs(publish_file, args, inputs) ||
+      !manifest.Open(output_path + "/manifest", inputs)) {
+    assert(false);
+    return false;
+  }
+
+  if (!manifest.IsDone("original")) {
+    if (!CopyData(publish_file, original_file) ||
+        !manifest.Done("original", {original_file})) {
+      assert(false);
+      return false;
+    }
+  }
+
+  std::vector<Fr> m;
+  if (!manifest.IsDone("matrix")) {
+    if (memory_budget) {
+      uint64_t row_size = bulletin.s * sizeof(Fr) + sizeof(G1);
+      uint64_t block_rows = std::max<uint64_t>(1, memory_budget / row_size);
+      if (!DataToMatrixAndSigma(original_file, bulletin.size, bulletin.n,
+                                column_num, block_rows, matrix_file,
+                                sigma_file)) {
+        assert(false);
+        return false;
+      }
+    } else {
+      if (!DataToM(original_file, bulletin.size, bulletin.n, column_num, m)) {
+        assert(false);
+        return false;
+      }
+
+      if (!SaveMatrix(matrix_file, m)) {
+        assert(false);
+        return false;
+      }
+
+      std::vector<G1> sigmas = CalcSigma(m, bulletin.n, bulletin.s);
+
+      if (!SaveSigma(sigma_file, sigmas)) {
+        assert(false);
+        return false;
+      }
+    }
+
+    if (!manifest.Done("matrix", {matrix_file, sigma_file})) {
+      assert(false);
+      return false;
+    }
+  }
+
+  // mkl
+  std::string value;
+  if (manifest.IsDone("sigma_mkl_tree") &&
+      manifest.GetValue("sigma_mkl_tree", "root", value)) {
+    HexStrToH256(value, bulletin.sigma_mkl_root);
+  } else {
+    if (!BuildSigmaMklTreeFile(sigma_file, bulletin.n, sigma_mkl_file,
+                               &bulletin.sigma_mkl_root) ||
+        !manifest.Done("sigma_mkl_tree", {sigma_mkl_file},
+                       {{"root", HexToStr(bulletin.sigma_mkl_root)}})) {
+      assert(false);
+      return false;
+    }
+  }
+
+  // meta
+  if (!SaveBulletin(bulletin_file, bulletin)) {
+    assert(false);
+    return false;
+  }
+
+#ifdef _DEBUG
+  if (m.empty() && !LoadMatrix(matrix_file, bulletin.n * bulletin.s, m)) {
+    assert(false);
+    return false;
+  }
+  std::string debug_data_file = original_file + ".debug";
+  if (!DecryptedRangeMToFile(debug_data_file, bulletin.size, bulletin.s, 0,
+                             bulletin.n, m.begin(), m.end())) {
+    assert(false);
+    return false;
+  }
+
+  if (!IsSameFile(debug_data_file, original_file)) {
+    assert(false);
+    return false;
+  }
+  fs::remove(debug_data_file);
+#endif
+
+  std::cout << "file size: " << bulletin.size << "\n";
+  std::cout << "n: " << bulletin.n << ", s: " << bulletin.s << "\n";
+
+  return true;
+}
+
+bool PublishPlainAppend(std::string publish_file, std::string output_path,
+                        std::string old_path, uint64_t memory_budget) {
+  using namespace scheme;
+  using namespace scheme::plain;
+  using namespace misc;
+
+  boost::system::error_code err;
+  if (fs::equivalent(old_path, output_path, err)) {
+    std::cerr << "output_dir must not be the old publish dir\n";
+    return false;
+  }
+
+  std::string old_bulletin_file = old_path + "/bulletin";
+  std::string old_original_file = old_path + "/private/original";
+  std::string old_matrix_file = old_path + "/private/matrix";
+  std::string old_sigma_file = old_path + "/public/sigma";
+  std::string old_sigma_mkl_file = old_path + "/public/sigma_mkl_tree";
+
+  Bulletin old_bulletin;
+  if (!LoadBulletin(old_bulletin_file, old_bulletin)) {
+    assert(false);
+    return false;
+  }
+
+  // only appending is supported, the published data must be unchanged
+  if (!IsFilePrefix(old_original_file, publish_file)) {
+    std::cerr << publish_file << " does not start with the old data\n";
+    return false;
+  }
+
+  std::string public_path = output_path + "/public";
+  if (!fs::is_directory(public_path, err) &&
+      !fs::create_directories(public_path, err)) {
+    assert(false);
+    return false;
+  }
+  std::string private_path = output_path + "/private";
+  if (!fs::is_directory(private_path, err) &&
+      !fs::create_directories(private_path, err)) {
+    assert(false);
+    return false;
+  }
+
+  uint64_t column_num = old_bulletin.s - 1;
+  Bulletin bulletin;
+  bulletin.size = fs::file_size(publish_file);
+  bulletin.s = old_bulletin.s;
+  bulletin.n = GetDataBlockCount(bulletin.size, column_num);
+
+  // the last old row is rebuilt if it was not full
+  uint64_t same_rows = old_bulletin.size / (31 * column_num);
+  assert(same_rows <= old_bulletin.n);
+
+  std::string bulletin_file = output_path + "/bulletin";
+  std::string original_file = private_path + "/original";
+  std::string matrix_file = private_path + "/matrix";
+  std::string sigma_file = public_path + "/sigma";
+  std::string sigma_mkl_file = public_path + "/sigma_mkl_tree";
+
   if (!CopyData(publish_file, original_file)) {
     assert(false);
     return false;
   }
 
+  uint64_t block_rows = std::max<uint64_t>(1, bulletin.n - same_rows);
+  if (memory_budget) {
+    uint64_t row_size = bulletin.s * sizeof(Fr) + sizeof(G1);
+    block_rows = std::max<uint64_t>(1, memory_budget / row_size);
+  }
+  if (!AppendMatrixAndSigma(original_file, bulletin.size, bulletin.n,
+                            column_num, block_rows, old_matrix_file,
+                            old_sigma_file, same_rows, matrix_file,
+                            sigma_file)) {
+    assert(false);
+    return false;
+  }
+
+  if (!ExtendSigmaMklTreeFile(old_sigma_mkl_file, old_bulletin.n, same_rows,
+                              sigma_file, bulletin.n, sigma_mkl_file,
+                              &bulletin.sigma_mkl_root)) {
+    assert(false);
+    return false;
+  }
+
+  if (!SaveBulletin(bulletin_file, bulletin)) {
+    assert(false);
+    return false;
+  }
+
+  std::cout << "file size: " << bulletin.size << "\n";
+  std::cout << "n: " << bulletin.n << ", s: " << bulletin.s
+            << ", reused rows: " << same_rows << "\n";
+  return true;
+}
+
+bool PublishTableAppend(std::string publish_file, std::string output_path,
+                        std::string old_path, scheme::table::Type table_type) {
+  using namespace scheme;
+  using namespace scheme::table;
+  using namespace misc;
+
+  boost::system::error_code err;
+  if (fs::equivalent(old_path, output_path, err)) {
+    std::cerr << "output_dir must not be the old publish dir\n";
+    return false;
+  }
+
+  std::string old_bulletin_file = old_path + "/bulletin";
+  std::string old_original_file = old_path + "/private/original";
+  std::string old_matrix_file = old_path + "/private/matrix";
+  std::string old_sigma_file = old_path + "/public/sigma";
+  std::string old_sigma_mkl_tree_file = old_path + "/public/sigma_mkl_tree";
+  std::string old_vrf_pk_file = old_path + "/public/vrf_pk";
+  std::string old_vrf_sk_file = old_path + "/private/vrf_sk";
+  std::string old_vrf_meta_file = old_path + "/public/vrf_meta";
+
+  Bulletin old_bulletin;
+  if (!LoadBulletin(old_bulletin_file, old_bulletin)) {
+    assert(false);
+    return false;
+  }
+
+  VrfMeta vrf_meta;
+  if (!LoadVrfMeta(old_vrf_meta_file, &old_bulletin.vrf_meta_digest,
+                   vrf_meta)) {
+    assert(false);
+    return false;
+  }
+
+  // the vrf key pair is kept, so the key_m of the old records are unchanged
+  vrf::Sk<> vrf_sk;
+  if (!LoadVrfSk(old_vrf_sk_file, vrf_sk)) {
+    assert(false);
+    return false;
+  }
+
+  std::string public_path = output_path + "/public";
+  if (!fs::is_directory(public_path, err) &&
+      !fs::create_directories(public_path, err)) {
+    assert(false);
+    return false;
+  }
+  std::string private_path = output_path + "/private";
+  if (!fs::is_directory(private_path, err) &&
+      !fs::create_directories(private_path, err)) {
+    assert(false);
+    return false;
+  }
+
+  std::string bulletin_file = output_path + "/bulletin";
+  std::string original_file = private_path + "/original";
+  std::string matrix_file = private_path + "/matrix";
+  std::string sigma_file = public_path + "/sigma";
+  std::string sigma_mkl_tree_file = public_path + "/sigma_mkl_tree";
+  std::string vrf_pk_file = public_path + "/vrf_pk";
+  std::string vrf_sk_file = private_path + "/vrf_sk";
+  std::string vrf_meta_file = public_path + "/vrf_meta";
+  std::vector<std::string> key_bp_files(vrf_meta.keys.size());
+  std::vector<std::string> key_m_files(vrf_meta.keys.size());
+  for (size_t i = 0; i < key_bp_files.size(); ++i) {
+    std::string str_i = std::to_string(i);
+    key_bp_files[i] = public_path + "/key_bp_" + str_i;
+    key_m_files[i] = public_path + "/key_m_" + str_i;
+  }
+
+  if (!CopyData(publish_file, original_file)) {
+    assert(false);
+    return false;
+  }
+
+  TableView old_table;
+  std::vector<std::string> old_column_names;
+  if (!LoadTable(old_original_file, table_type, old_column_names,
+                 old_table)) {
+    assert(false);
+    return false;
+  }
+
+  TableView table;
+  std::vector<std::string> column_names;
+  if (!LoadTable(original_file, table_type, column_names, table)) {
+    assert(false);
+    return false;
+  }
+
+  if (column_names != vrf_meta.column_names ||
+      old_column_names != vrf_meta.column_names) {
+    std::cerr << "the columns are changed\n";
+    return false;
+  }
+
+  std::vector<uint64_t> vrf_colnums_index(vrf_meta.keys.size());
+  std::vector<uint64_t> unique_index;
+  for (uint64_t i = 0; i < vrf_meta.keys.size(); ++i) {
+    vrf_colnums_index[i] = vrf_meta.keys[i].column_index;
+    if (vrf_meta.keys[i].unique) unique_index.push_back(vrf_colnums_index[i]);
+  }
+
+  // UniqueRecords() keeps the order, so the old records are still the prefix
+  UniqueRecords(old_table, unique_index);
+  UniqueRecords(table, unique_index);
+
+  uint64_t same_count = old_bulletin.n - 1;  // the last one is the pad row
+  if (old_table.size() != same_count || table.size() < same_count ||
+      !std::equal(old_table.fields.begin(), old_table.fields.end(),
+                  table.fields.begin())) {
+    std::cerr << publish_file << " does not start with the old records\n";
+    return false;
+  }
+  old_table = TableView();
+
+  PadRubbishRow(table);
+
+  Bulletin bulletin;
+  bulletin.n = table.size();
+  bulletin.s = old_bulletin.s;
+  auto record_fr_num = bulletin.s - 1 - vrf_meta.keys.size();
+  auto max_record_size = GetMaxRecordSize(table);
+  if ((max_record_size + 30) / 31 > record_fr_num) {
+    std::cerr << "the new records are too long, publish them again\n";
+    return false;
+  }
+
   std::vector<Fr> m;
-  if (!DataToM(original_file, bulletin.size, bulletin.n, column_num, m)) {
+  if (!LoadMatrix(old_matrix_file, old_bulletin.n * bulletin.s, m)) {
     assert(false);
     return false;
   }
 
-  if (!SaveMatrix(matrix_file, m)) {
+  std::vector<G1> sigmas;
+  if (!LoadSigma(old_sigma_file, old_bulletin.n, &old_bulletin.sigma_mkl_root,
+                 sigmas)) {
     assert(false);
     return false;
   }
 
-  std::vector<G1> sigmas = CalcSigma(m, bulletin.n, bulletin.s);
+  // only the new records and the pad row
+  TableView new_table;
+  new_table.col_num = table.col_num;
+  new_table.fields.assign(table.fields.begin() + same_count * table.col_num,
+                          table.fields.end());
+  std::vector<Fr> new_m(new_table.size() * bulletin.s);
+  DataToM(new_table, vrf_colnums_index, bulletin.s, vrf_sk, new_m);
+  std::vector<G1> new_sigmas = CalcSigma(new_m, new_table.size(), bulletin.s);
+
+  m.resize(same_count * bulletin.s);
+  m.insert(m.end(), new_m.begin(), new_m.end());
+  sigmas.resize(same_count);
+  sigmas.insert(sigmas.end(), new_sigmas.begin(), new_sigmas.end());
+
+  if (!SaveMatrix(matrix_file, m)) {
+    assert(false);
+    return false;
+  }
 
   if (!SaveSigma(sigma_file, sigmas)) {
     assert(false);
     return false;
   }
 
-  // mkl
-  auto sigma_mkl_tree = BuildSigmaMklTree(sigmas);
-  if (!SaveMkl(sigma_mkl_file, sigma_mkl_tree)) {
+  if (!ExtendSigmaMklTreeFile(old_sigma_mkl_tree_file, old_bulletin.n,
+                              same_count, sigma_file, bulletin.n,
+                              sigma_mkl_tree_file, &bulletin.sigma_mkl_root)) {
+    assert(false);
+    return false;
+  }
+
+  // vrf_meta.pk_digest is unchanged
+  if (!CopyData(old_vrf_pk_file, vrf_pk_file) ||
+      !CopyData(old_vrf_sk_file, vrf_sk_file)) {
+    assert(false);
+    return false;
+  }
+
+  // the sigma root changed, so all of the key bp proofs are rebuilt
+  if (!BuildKeys(bulletin, m, sigmas, key_m_files, key_bp_files, vrf_meta)) {
+    assert(false);
+    return false;
+  }
+
+  if (!SaveVrfMeta(vrf_meta_file, vrf_meta)) {
+    assert(false);
+    return false;
+  }
+
+  if (!GetFileSha256(vrf_meta_file, bulletin.vrf_meta_digest)) {
     assert(false);
     return false;
   }
-  bulletin.sigma_mkl_root = sigma_mkl_tree.back();
 
-  // meta
   if (!SaveBulletin(bulletin_file, bulletin)) {
     assert(false);
     return false;
   }
 
-#ifdef _DEBUG
-  std::string debug_data_file = original_file + ".debug";
-  if (!DecryptedRangeMToFile(debug_data_file, bulletin.size, bulletin.s, 0,
-                             bulletin.n, m.begin(), m.end())) {
+  std::cout << "n: " << bulletin.n << ", s: " << bulletin.s
+            << ", reused records: " << same_count << "\n";
+  return true;
+}
+
+bool ConvertTable(std::string csv_file, std::string bin_file) {
+  using namespace scheme::table;
+
+  std::vector<std::string> col_names;
+  TableView table;
+  if (!LoadCsv(csv_file, col_names, table)) {
     assert(false);
     return false;
   }
 
-  if (!IsSameFile(debug_data_file, original_file)) {
+  if (!SaveBinTable(bin_file, col_names, table)) {
     assert(false);
     return false;
   }
-  fs::remove(debug_data_file);
-#endif
 
-  std::cout << "file size: " << bulletin.size << "\n";
-  std::cout << "n: " << bulletin.n << ", s: " << bulletin.s << "\n";
+  std::cout << "rows: " << table.size() << ", columns: " << table.col_num
+            << ", bin table: " << bin_file << "\n";
+  return true;
+}
+
+bool ConvertSigma(std::string publish_path) {
+  using namespace scheme;
+
+  std::string bulletin_file = publish_path + "/bulletin";
+  std::string public_path = publish_path + "/public";
+  std::string sigma_file = public_path + "/sigma";
+  std::string sigma_affine_file = public_path + "/sigma_affine";
+
+  Mode mode;
+  if (!GetBulletinMode(bulletin_file, mode)) {
+    assert(false);
+    return false;
+  }
 
+  uint64_t n;
+  h256_t sigma_mkl_root;
+  if (mode == Mode::kPlain) {
+    plain::Bulletin bulletin;
+    if (!plain::LoadBulletin(bulletin_file, bulletin)) {
+      assert(false);
+      return false;
+    }
+    n = bulletin.n;
+    sigma_mkl_root = bulletin.sigma_mkl_root;
+  } else {
+    table::Bulletin bulletin;
+    if (!table::LoadBulletin(bulletin_file, bulletin)) {
+      assert(false);
+      return false;
+    }
+    n = bulletin.n;
+    sigma_mkl_root = bulletin.sigma_mkl_root;
+  }
+
+  if (!ConvertSigmaToAffine(sigma_file, sigma_affine_file, n,
+                            sigma_mkl_root)) {
+    assert(false);
+    return false;
+  }
+
+  std::cout << "n: " << n << ", sigma_affine: " << sigma_affine_file << "\n";
   return true;
-}
\ No newline at end of file
+}
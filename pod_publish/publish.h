@@ -14,5 +14,19 @@ bool PublishTable(std::string publish_file, std::string output_path,
                   std::vector<uint64_t> vrf_colnums_index,
                   std::vector<bool> unique_key);
 
+// memory_budget: bytes of m and sigma kept in memory, 0 means no limit.
 bool PublishPlain(std::string publish_file, std::string output_path,
-                  uint64_t column_num);
\ No newline at end of file
+                  uint64_t column_num, uint64_t memory_budget = 0);
+
+// Publish the grown file to a new output_path, reusing what is unchanged in the
+// publish of old_path. The old publish is not touched, so the sessions which
+// use its bulletin are still valid.
+bool PublishPlainAppend(std::string publish_file, std::string output_path,
+                        std::string old_path, uint64_t memory_budget = 0);
+bool PublishTableAppend(std::string publish_file, std::string output_path,
+                        std::string old_path, scheme::table::Type table_type);
+
+bool ConvertSigma(std::string publish_path);
+
+// csv to the columnar bin table which can be published with -t bin
+bool ConvertTable(std::string csv_file, std::string bin_file);
@@ -9,20 +9,13 @@
 #include <vector>
 
 #include "ecc.h"
+#include "keccak_batch.h"
 #include "mpz.h"
 #include "parallel.h"
 #include "tick.h"
 
-inline Fr ChainKeccak256(uint8_t const* seed_buf, uint64_t seed_len,
-                         uint64_t index) {
-  uint64_t index_be = boost::endian::native_to_big(index);
-
-  h256_t digest_be;
-  CryptoPP::Keccak_256 hash;
-  hash.Update(seed_buf, seed_len);
-  hash.Update((uint8_t const*)&index_be, sizeof(index_be));
-  hash.Final(digest_be.data());
-
+namespace details {
+inline Fr ChainDigestToFr(h256_t const& digest_be) {
   // setArrayMaskMod want little endian
   h256_t digest_le;
   for (size_t i = 0; i < digest_be.size(); ++i) {
@@ -38,20 +31,76 @@ inline Fr ChainKeccak256(uint8_t const* seed_buf, uint64_t seed_len,
 
   return r;
 }
+}  // namespace details
+
+inline Fr ChainKeccak256(uint8_t const* seed_buf, uint64_t seed_len,
+                         uint64_t index) {
+  uint64_t index_be = boost::endian::native_to_big(index);
+
+  h256_t digest_be;
+  CryptoPP::Keccak_256 hash;
+  hash.Update(seed_buf, seed_len);
+  hash.Update((uint8_t const*)&index_be, sizeof(index_be));
+  hash.Final(digest_be.data());
+
+  return details::ChainDigestToFr(digest_be);
+}
 
 inline Fr ChainKeccak256(h256_t const& seed, uint64_t index) {
   return ChainKeccak256(seed.data(), seed.size(), index);
 }
 
+// out[i] = ChainKeccak256(seed_buf, seed_len, begin + i), hashed by the
+// multi-buffer keccak
+inline void ChainKeccak256Batch(uint8_t const* seed_buf, uint64_t seed_len,
+                                uint64_t begin, uint64_t count, Fr* out) {
+  size_t msg_size = seed_len + sizeof(uint64_t);
+  std::vector<uint8_t> msgs(count * msg_size);
+  for (uint64_t i = 0; i < count; ++i) {
+    uint8_t* p = msgs.data() + i * msg_size;
+    uint64_t index_be = boost::endian::native_to_big(begin + i);
+    memcpy(p, seed_buf, seed_len);
+    memcpy(p + seed_len, &index_be, sizeof(index_be));
+  }
+
+  std::vector<h256_t> digests(count);
+  keccak::Keccak256Batch(msgs.data(), msg_size, digests.data(), count);
+  for (uint64_t i = 0; i < count; ++i) {
+    out[i] = details::ChainDigestToFr(digests[i]);
+  }
+}
+
+inline void ChainKeccak256Batch(h256_t const& seed, uint64_t begin,
+                                uint64_t count, Fr* out) {
+  ChainKeccak256Batch(seed.data(), seed.size(), begin, count, out);
+}
+
+// v[i] = ChainKeccak256(seed_buf, seed_len, i) for i in [0, count)
+inline void ChainKeccak256(uint8_t const* seed_buf, uint64_t seed_len,
+                           uint64_t count, std::vector<Fr>& v) {
+  static constexpr uint64_t kChunk = 1024;
+  v.resize(count);
+  auto parallel_f = [&v, seed_buf, seed_len, count](int64_t i) {
+    uint64_t offset = i * kChunk;
+    ChainKeccak256Batch(seed_buf, seed_len, offset,
+                        std::min(kChunk, count - offset), v.data() + offset);
+  };
+  parallel::For((int64_t)((count + kChunk - 1) / kChunk), parallel_f);
+}
+
 inline void ChainKeccak256(h256_t const& seed, uint64_t begin, uint64_t end,
                            std::vector<Fr>& v) {
   Tick _tick_(__FUNCTION__);
-  v.resize(end - begin);
+  static constexpr uint64_t kChunk = 1024;
+  auto count = end - begin;
+  v.resize(count);
 
-  auto parallel_f = [&v, &seed, begin](uint64_t i) mutable {
-    v[i - begin] = ChainKeccak256(seed, i);
+  auto parallel_f = [&v, &seed, begin, count](int64_t i) {
+    uint64_t offset = i * kChunk;
+    ChainKeccak256Batch(seed, begin + offset, std::min(kChunk, count - offset),
+                        v.data() + offset);
   };
-  parallel::For(begin, end, parallel_f);
+  parallel::For((int64_t)((count + kChunk - 1) / kChunk), parallel_f);
 }
 
 inline void ChainKeccak256(h256_t const& seed, uint64_t count,
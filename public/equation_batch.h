@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ecc.h"
+#include "multiexp.h"
+#include "parallel.h"
+#include "pds_pub.h"
+
+// Collects the final group equations of several proofs,
+//   sum(left[j].second * left[j].first) == com(x, r)
+// and checks them at once: every equation is scaled by a random rho and all
+// of them are summed into one multiexp over the pds generators and the
+// points. If the sum is zero, all of the equations hold except with
+// negligible probability. The rho are the verifier's own randomness, they
+// are never seen by the prover.
+class EquationBatch {
+ public:
+  void Add(std::vector<std::pair<G1, Fr>> const& left, Fr const* x, size_t n,
+           Fr const& r) {
+    assert(PdsPub::kGSize >= n);
+    Fr rho = FrRand();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto const& i : left) {
+      points_.push_back(i.first);
+      scalars_.push_back(i.second * rho);
+    }
+    if (gx_.size() < n) gx_.resize(n, FrZero());
+    for (size_t i = 0; i < n; ++i) gx_[i] += x[i] * rho;
+    hr_ += r * rho;
+    ++count_;
+  }
+
+  void Add(std::vector<std::pair<G1, Fr>> const& left,
+           std::vector<Fr> const& x, Fr const& r) {
+    Add(left, x.data(), x.size(), r);
+  }
+
+  void Add(std::vector<std::pair<G1, Fr>> const& left, Fr const& x,
+           Fr const& r) {
+    Add(left, &x, 1, r);
+  }
+
+  void Merge(EquationBatch const& other) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    points_.insert(points_.end(), other.points_.begin(), other.points_.end());
+    scalars_.insert(scalars_.end(), other.scalars_.begin(),
+                    other.scalars_.end());
+    if (gx_.size() < other.gx_.size()) gx_.resize(other.gx_.size(), FrZero());
+    for (size_t i = 0; i < other.gx_.size(); ++i) gx_[i] += other.gx_[i];
+    hr_ += other.hr_;
+    count_ += other.count_;
+  }
+
+  int64_t count() const { return count_; }
+
+  // sum(scalars * points) - com(gx, hr) == 0, in parallel pieces
+  bool Check() const {
+    Tick tick(__FUNCTION__, std::to_string(count_));
+    static constexpr int64_t kPiece = 8 * 1024;
+    auto const& pds_pub = GetPdsPub();
+    auto point_count = (int64_t)points_.size();
+    auto total = point_count + (int64_t)gx_.size() + 1;
+    auto get_g = [this, &pds_pub, point_count](int64_t i) -> G1 const& {
+      if (i < point_count) return points_[i];
+      i -= point_count;
+      return i ? pds_pub.g()[i - 1] : pds_pub.h();
+    };
+    auto get_f = [this, point_count](int64_t i) -> Fr {
+      if (i < point_count) return scalars_[i];
+      i -= point_count;
+      return i ? -gx_[i - 1] : -hr_;
+    };
+
+    auto piece_count = (total + kPiece - 1) / kPiece;
+    std::vector<G1> sums(piece_count);
+    auto parallel_f = [&sums, &get_g, &get_f, total](int64_t p) {
+      auto begin = p * kPiece;
+      auto size = std::min(kPiece, total - begin);
+      auto piece_g = [&get_g, begin](int64_t i) -> G1 const& {
+        return get_g(begin + i);
+      };
+      auto piece_f = [&get_f, begin](int64_t i) { return get_f(begin + i); };
+      sums[p] = MultiExpBdlo12Inner<G1>(piece_g, piece_f, size);
+    };
+    parallel::For(piece_count, parallel_f);
+    return parallel::Accumulate(sums.begin(), sums.end(), G1Zero()) ==
+           G1Zero();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<G1> points_;
+  std::vector<Fr> scalars_;
+  std::vector<Fr> gx_;
+  Fr hr_ = FrZero();
+  int64_t count_ = 0;
+};
@@ -10,6 +10,7 @@
 
 #include "ecc.h"
 #include "ecc_pub.h"
+#include "keccak_batch.h"
 
 inline void HashUpdate(CryptoPP::Keccak_256& hash, uint64_t d) {
   auto big_d = boost::endian::native_to_big(d);
@@ -48,14 +49,26 @@ inline void HashUpdate(CryptoPP::Keccak_256& hash, std::vector<Fr> const& d) {
 inline void ComputeFst(h256_t const& seed, std::string const& salt,
                        std::vector<Fr>& c) {
   assert(!c.empty());
-  auto parallel_f = [&seed, &c, &salt](int64_t i) {
-    CryptoPP::Keccak_256 hash;
-    h256_t digest;
-    HashUpdate(hash, seed);
-    HashUpdate(hash, salt);
-    HashUpdate(hash, i);
-    hash.Final(digest.data());
-    c[i] = H256ToFr(digest);
+  // seed || salt || i, hashed by the multi-buffer keccak in chunks
+  static constexpr size_t kChunk = 1024;
+  size_t msg_size = seed.size() + salt.size() + sizeof(uint64_t);
+  size_t chunk_count = (c.size() + kChunk - 1) / kChunk;
+  auto parallel_f = [&seed, &c, &salt, msg_size](int64_t chunk) {
+    size_t begin = chunk * kChunk;
+    size_t count = std::min(kChunk, c.size() - begin);
+    std::vector<uint8_t> msgs(count * msg_size);
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t* p = msgs.data() + i * msg_size;
+      auto big_i = boost::endian::native_to_big((uint64_t)(begin + i));
+      memcpy(p, seed.data(), seed.size());
+      memcpy(p + seed.size(), salt.data(), salt.size());
+      memcpy(p + seed.size() + salt.size(), &big_i, sizeof(big_i));
+    }
+    std::vector<h256_t> digests(count);
+    keccak::Keccak256Batch(msgs.data(), msg_size, digests.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+      c[begin + i] = H256ToFr(digests[i]);
+    }
   };
-  parallel::For(c.size(), parallel_f, c.size() < 16 * 1024);
+  parallel::For((int64_t)chunk_count, parallel_f, chunk_count < 16);
 }
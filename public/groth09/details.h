@@ -10,7 +10,9 @@
 
 #include "../ecc.h"
 #include "../ecc_pub.h"
+#include "../equation_batch.h"
 #include "../fst.h"
+#include "../keccak_batch.h"
 #include "../misc.h"
 #include "../multiexp.h"
 #include "../parallel.h"
@@ -21,15 +23,19 @@
 
 namespace groth09::details {
 
-inline G1 ComputeCommitment(std::vector<Fr> const& x, Fr const& r) {
+inline G1 ComputeCommitment(Fr const* x, size_t n, Fr const& r) {
   auto const& pds_pub = GetPdsPub();
-  // Tick tick(__FUNCTION__, std::to_string(x.size()));
-  assert(PdsPub::kGSize >= x.size());
+  // Tick tick(__FUNCTION__, std::to_string(n));
+  assert(PdsPub::kGSize >= n);
   auto get_g = [&pds_pub](int64_t i) -> G1 const& {
     return i ? pds_pub.g()[i - 1] : pds_pub.h();
   };
-  auto get_f = [&x, &r](int64_t i) -> Fr const& { return i ? x[i - 1] : r; };
-  return MultiExpBdlo12Inner<G1>(get_g, get_f, x.size() + 1);
+  auto get_f = [x, &r](int64_t i) -> Fr const& { return i ? x[i - 1] : r; };
+  return MultiExpBdlo12Inner<G1>(get_g, get_f, n + 1);
+}
+
+inline G1 ComputeCommitment(std::vector<Fr> const& x, Fr const& r) {
+  return ComputeCommitment(x.data(), x.size(), r);
 }
 
 inline G1 ComputeCommitment(Fr const& x, Fr const& r) {
@@ -77,19 +83,22 @@ inline void PrintVector(std::vector<Fr> const& a) {
 
 inline void BuildChallengeVector(std::vector<Fr>& challenge, h256_t const& seed,
                                  std::string const& suffix, int64_t count) {
-  auto hash = [&suffix, &seed](int64_t i) {
-    CryptoPP::Keccak_256 hash;
-    HashUpdate(hash, seed);
-    hash.Update((uint8_t const*)&i, sizeof(i));
-    HashUpdate(hash, suffix);
-    h256_t digest;
-    hash.Final(digest.data());
-    return H256ToFr(digest);
-  };
+  // seed || i || suffix, all of the messages have the same length
+  size_t msg_size = seed.size() + sizeof(int64_t) + suffix.size();
+  std::vector<uint8_t> msgs(count * msg_size);
+  for (int64_t i = 0; i < count; ++i) {
+    uint8_t* p = msgs.data() + i * msg_size;
+    memcpy(p, seed.data(), seed.size());
+    memcpy(p + seed.size(), &i, sizeof(i));
+    memcpy(p + seed.size() + sizeof(i), suffix.data(), suffix.size());
+  }
+
+  std::vector<h256_t> digests(count);
+  keccak::Keccak256Batch(msgs.data(), msg_size, digests.data(), count);
 
   challenge.resize(count);
   for (int64_t i = 0; i < count; ++i) {
-    challenge[i] = hash(i);
+    challenge[i] = H256ToFr(digests[i]);
   }
 }
 
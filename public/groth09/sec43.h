@@ -286,8 +286,10 @@ struct VerifierInput {
   CommitmentPub const& com_pub;
 };
 
+// if batch is not null the final equations are added into it
 inline bool RomVerify(RomProof const& rom_proof, h256_t const& rom_seed,
-                      VerifierInput const& input) {
+                      VerifierInput const& input,
+                      EquationBatch* batch = nullptr) {
   // Tick tick(__FUNCTION__);
   auto m = rom_proof.m();
   auto n = rom_proof.n();
@@ -301,8 +303,8 @@ inline bool RomVerify(RomProof const& rom_proof, h256_t const& rom_seed,
 
   std::array<parallel::Task, 2> tasks;
   bool ret_53 = false;
-  tasks[0] = [&ret_53, &rom_proof, &input, m, &com_pub, &k, &t,
-              &seed]() mutable {
+  tasks[0] = [&ret_53, &rom_proof, &input, m, &com_pub, &k, &t, &seed,
+              batch]() mutable {
     sec53::CommitmentPub com_pub_53;
     com_pub_53.c = rom_proof.c;
     com_pub_53.b = input.com_pub.b;
@@ -313,15 +315,15 @@ inline bool RomVerify(RomProof const& rom_proof, h256_t const& rom_seed,
     parallel::For(m, parallel_f, m < 1024);
 
     sec53::VerifierInput input_53(&t, com_pub_53);
-    ret_53 = sec53::RomVerify(rom_proof.proof_53, seed, input_53);
+    ret_53 = sec53::RomVerify(rom_proof.proof_53, seed, input_53, batch);
   };
 
   bool ret_a2 = false;
-  tasks[1] = [&ret_a2, &com_pub, &rom_proof, &t, &k, &seed]() {
+  tasks[1] = [&ret_a2, &com_pub, &rom_proof, &t, &k, &seed, batch]() {
     hyrax::a2::CommitmentPub com_pub_hy(MultiExpBdlo12(com_pub.c, k),
                                         rom_proof.c);
     hyrax::a2::VerifierInput input_hy(t, com_pub_hy);
-    ret_a2 = hyrax::a2::RomVerify(rom_proof.proof_a2, seed, input_hy);
+    ret_a2 = hyrax::a2::RomVerify(rom_proof.proof_a2, seed, input_hy, batch);
   };
 
   parallel::Invoke(tasks);
@@ -337,9 +337,10 @@ struct VerifierInput {
   CommitmentPub const& com_pub;
 };
 
+// if batch is not null the equations are added into it instead of checked
 inline bool VerifyInternal(VerifierInput const& input, Fr const& challenge,
                            CommitmentExtPub const& com_ext_pub,
-                           Proof const& proof) {
+                           Proof const& proof, EquationBatch* batch = nullptr) {
   using details::ComputeCommitment;
 
   auto const n = proof.fx.size();
@@ -351,6 +352,31 @@ inline bool VerifyInternal(VerifierInput const& input, Fr const& challenge,
   bool ret2 = false;
   auto const& com_pub = input.com_pub;
 
+  auto compute_fz = [&input, &proof, n]() {
+    if (input.t) {
+      std::vector<Fr> proof_fyt(n);
+      details::HadamardProduct(proof_fyt, proof.fy, *input.t);
+      return InnerProduct(proof.fx, proof_fyt);
+    } else {
+      return InnerProduct(proof.fx, proof.fy);
+    }
+  };
+
+  if (batch) {
+    Fr alpha = FrRand();
+    Fr e_alpha = challenge * alpha;
+    batch->Add({{com_pub.a, e_alpha},
+                {com_ext_pub.ad, alpha},
+                {com_pub.b, challenge},
+                {com_ext_pub.bd, FrOne()}},
+               proof.fx * alpha + proof.fy, alpha * proof.rx + proof.sy);
+    batch->Add({{com_pub.c, challenge * challenge},
+                {com_ext_pub.c1, challenge},
+                {com_ext_pub.c0, FrOne()}},
+               compute_fz(), proof.tz);
+    return true;
+  }
+
   std::array<parallel::Task, 2> tasks;
   tasks[0] = [&ret1, &com_pub, &challenge, &com_ext_pub, &proof]() {
     Fr alpha = FrRand();
@@ -365,20 +391,13 @@ inline bool VerifyInternal(VerifierInput const& input, Fr const& challenge,
     assert(ret1);
   };
 
-  tasks[1] = [&ret2, &com_pub, &challenge, &com_ext_pub, &proof, &input, n]() {
+  tasks[1] = [&ret2, &com_pub, &challenge, &com_ext_pub, &proof,
+              &compute_fz]() {
     // c^(e^2) * c_1^e * c_0 == com(f_x * f_y , t_z)
     Fr e2_square = challenge * challenge;
     G1 left =
         com_pub.c * e2_square + com_ext_pub.c1 * challenge + com_ext_pub.c0;
-    Fr fz = [&input, &proof, n]() {
-      if (input.t) {
-        std::vector<Fr> proof_fyt(n);
-        details::HadamardProduct(proof_fyt, proof.fy, *input.t);
-        return InnerProduct(proof.fx, proof_fyt);
-      } else {
-        return InnerProduct(proof.fx, proof.fy);
-      }
-    }();
+    Fr fz = compute_fz();
 
     G1 right = ComputeCommitment(fz, proof.tz);
     ret2 = left == right;
@@ -409,7 +428,8 @@ inline void RomProve(RomProof& rom_proof, h256_t const& common_seed,
 }
 
 inline bool RomVerify(RomProof const& rom_proof, h256_t const& common_seed,
-                      VerifierInput const& input) {
+                      VerifierInput const& input,
+                      EquationBatch* batch = nullptr) {
   // Tick tick(__FUNCTION__);
   assert(PdsPub::kGSize >= rom_proof.n());
 
@@ -418,7 +438,7 @@ inline bool RomVerify(RomProof const& rom_proof, h256_t const& common_seed,
   Fr challenge = H256ToFr(seed);
 
   return VerifyInternal(input, challenge, rom_proof.com_ext_pub,
-                        rom_proof.proof);
+                        rom_proof.proof, batch);
 }
 
 inline bool TestRom(int64_t n) {
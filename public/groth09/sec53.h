@@ -486,7 +486,8 @@ inline void RomProve(RomProof& rom_proof, h256_t seed, ProverInput input,
 }
 
 inline bool RomVerify(RomProof const& rom_proof, h256_t seed,
-                      VerifierInput const& input) {
+                      VerifierInput const& input,
+                      EquationBatch* batch = nullptr) {
   // Tick tick(__FUNCTION__);
   if (!rom_proof.CheckFormat(input.m())) {
     assert(false);
@@ -528,7 +529,8 @@ inline bool RomVerify(RomProof const& rom_proof, h256_t seed,
 
   sec51::CommitmentPub com_pub_51(com_pub.a[0], com_pub.b[0], com_pub.c);
   sec51::VerifierInput verifier_input_51(input.t, com_pub_51);
-  return sec51::RomVerify(rom_proof.rom_proof_51, seed, verifier_input_51);
+  return sec51::RomVerify(rom_proof.rom_proof_51, seed, verifier_input_51,
+                          batch);
 }
 
 inline bool TestRom(int64_t m, int64_t n) {
@@ -102,9 +102,10 @@ struct VerifierInput {
 };
 
 // com(n) + com(1) + ip(n)
+// if batch is not null the equations are added into it instead of checked
 inline bool VerifyInternal(VerifierInput const& input, Fr const& challenge,
                            CommitmentExtPub const& com_ext_pub,
-                           Proof const& proof) {
+                           Proof const& proof, EquationBatch* batch = nullptr) {
   // Tick tick(__FUNCTION__);
   using details::ComputeCommitment;
 
@@ -112,6 +113,14 @@ inline bool VerifyInternal(VerifierInput const& input, Fr const& challenge,
 
   auto const& com_pub = input.com_pub;
 
+  if (batch) {
+    batch->Add({{com_pub.xi, challenge}, {com_ext_pub.delta, FrOne()}},
+               proof.z, proof.z_delta);
+    batch->Add({{com_pub.tau, challenge}, {com_ext_pub.beta, FrOne()}},
+               InnerProduct(proof.z, input.a), proof.z_beta);
+    return true;
+  }
+
   std::array<parallel::Task, 2> tasks;
   bool ret1 = false;
   tasks[0] = [&ret1, &com_pub, &com_ext_pub, &challenge, &proof]() {
@@ -219,7 +228,8 @@ inline void RomProve(RomProof& rom_proof, h256_t const& common_seed,
 }
 
 inline bool RomVerify(RomProof const& rom_proof, h256_t const& common_seed,
-                      VerifierInput const& input) {
+                      VerifierInput const& input,
+                      EquationBatch* batch = nullptr) {
   // Tick tick(__FUNCTION__);
   assert(PdsPub::kGSize >= rom_proof.n());
   if (input.a.size() != rom_proof.proof.z.size() || input.a.empty())
@@ -230,7 +240,7 @@ inline bool RomVerify(RomProof const& rom_proof, h256_t const& common_seed,
   Fr challenge = H256ToFr(seed);
 
   return VerifyInternal(input, challenge, rom_proof.com_ext_pub,
-                        rom_proof.proof);
+                        rom_proof.proof, batch);
 }
 
 inline bool TestRom(int64_t n) {
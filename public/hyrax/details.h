@@ -9,6 +9,7 @@
 
 #include "../ecc.h"
 #include "../ecc_pub.h"
+#include "../equation_batch.h"
 #include "../fst.h"
 #include "../misc.h"
 #include "../multiexp.h"
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "basic_types.h"
+#include "parallel.h"
+
+// Multi-buffer Keccak-256, the digest is the same as CryptoPP::Keccak_256
+// (original keccak padding, not sha3). The messages of one call must have
+// the same length, and are hashed 8 (avx512) or 4 (avx2) at a time, or one
+// by one without simd. The lane width is chosen at compile time (-march).
+// NOTE: the lanes are loaded as little endian uint64_t.
+
+namespace keccak {
+
+namespace details {
+
+inline constexpr size_t kRate = 136;  // (1600 - 256 * 2) / 8
+inline constexpr size_t kRateWords = kRate / 8;
+
+inline constexpr uint64_t kRoundConst[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+inline constexpr int kRotc[24] = {1,  3,  6,  10, 15, 21, 28, 36,
+                                  45, 55, 2,  14, 27, 41, 56, 8,
+                                  25, 43, 62, 18, 39, 61, 20, 44};
+
+inline constexpr int kPiln[24] = {10, 7,  11, 17, 18, 3, 5,  16,
+                                  8,  21, 24, 4,  15, 23, 19, 13,
+                                  12, 2,  20, 14, 22, 9,  6,  1};
+
+// lane ops, one overload set per lane type
+struct Scalar {
+  typedef uint64_t V;
+  static constexpr size_t kLanes = 1;
+  static V Load(uint64_t const* p) { return *p; }
+  static void Store(uint64_t* p, V v) { *p = v; }
+  static V Set1(uint64_t a) { return a; }
+  static V Xor(V a, V b) { return a ^ b; }
+  static V AndNot(V a, V b) { return ~a & b; }  // ~a & b
+  static V Rol(V a, int n) { return (a << n) | (a >> (64 - n)); }
+};
+
+#ifdef __AVX2__
+struct Avx2 {
+  typedef __m256i V;
+  static constexpr size_t kLanes = 4;
+  static V Load(uint64_t const* p) {
+    return _mm256_loadu_si256((__m256i const*)p);
+  }
+  static void Store(uint64_t* p, V v) { _mm256_storeu_si256((__m256i*)p, v); }
+  static V Set1(uint64_t a) { return _mm256_set1_epi64x((int64_t)a); }
+  static V Xor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V AndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+  static V Rol(V a, int n) {
+    return _mm256_or_si256(_mm256_sll_epi64(a, _mm_cvtsi32_si128(n)),
+                           _mm256_srl_epi64(a, _mm_cvtsi32_si128(64 - n)));
+  }
+};
+#endif
+
+#ifdef __AVX512F__
+struct Avx512 {
+  typedef __m512i V;
+  static constexpr size_t kLanes = 8;
+  static V Load(uint64_t const* p) { return _mm512_loadu_si512(p); }
+  static void Store(uint64_t* p, V v) { _mm512_storeu_si512(p, v); }
+  static V Set1(uint64_t a) { return _mm512_set1_epi64((int64_t)a); }
+  static V Xor(V a, V b) { return _mm512_xor_si512(a, b); }
+  static V AndNot(V a, V b) { return _mm512_andnot_si512(a, b); }
+  static V Rol(V a, int n) {
+    return _mm512_rolv_epi64(a, _mm512_set1_epi64(n));
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+typedef Avx512 Simd;
+#elif defined(__AVX2__)
+typedef Avx2 Simd;
+#else
+typedef Scalar Simd;
+#endif
+
+template <typename L>
+inline void KeccakF1600(typename L::V st[25]) {
+  typedef typename L::V V;
+  V bc[5];
+  for (int round = 0; round < 24; ++round) {
+    // theta
+    for (int i = 0; i < 5; ++i) {
+      bc[i] = L::Xor(L::Xor(st[i], st[i + 5]), L::Xor(st[i + 10], st[i + 15]));
+      bc[i] = L::Xor(bc[i], st[i + 20]);
+    }
+    for (int i = 0; i < 5; ++i) {
+      V t = L::Xor(bc[(i + 4) % 5], L::Rol(bc[(i + 1) % 5], 1));
+      for (int j = 0; j < 25; j += 5) st[j + i] = L::Xor(st[j + i], t);
+    }
+
+    // rho pi
+    V t = st[1];
+    for (int i = 0; i < 24; ++i) {
+      int j = kPiln[i];
+      V tmp = st[j];
+      st[j] = L::Rol(t, kRotc[i]);
+      t = tmp;
+    }
+
+    // chi
+    for (int j = 0; j < 25; j += 5) {
+      for (int i = 0; i < 5; ++i) bc[i] = st[j + i];
+      for (int i = 0; i < 5; ++i) {
+        V t = L::AndNot(bc[(i + 1) % 5], bc[(i + 2) % 5]);
+        st[j + i] = L::Xor(st[j + i], t);
+      }
+    }
+
+    // iota
+    st[0] = L::Xor(st[0], L::Set1(kRoundConst[round]));
+  }
+}
+
+// hash L::kLanes messages of len bytes, msgs[l] -> outs[l]
+template <typename L>
+inline void Keccak256Lanes(uint8_t const* const* msgs, size_t len,
+                           uint8_t* const* outs) {
+  typedef typename L::V V;
+  constexpr size_t kLanes = L::kLanes;
+  V st[25];
+  for (auto& i : st) i = L::Set1(0);
+
+  // block[w][l] is the w-th word of lane l
+  uint64_t block[kRateWords][kLanes];
+  size_t offset = 0;
+  for (bool last = false; !last;) {
+    size_t size = len - offset;
+    last = size < kRate;
+    for (size_t l = 0; l < kLanes; ++l) {
+      uint8_t buf[kRate];
+      if (last) {
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, msgs[l] + offset, size);
+        buf[size] ^= 0x01;
+        buf[kRate - 1] ^= 0x80;
+      } else {
+        memcpy(buf, msgs[l] + offset, kRate);
+      }
+      for (size_t w = 0; w < kRateWords; ++w) {
+        memcpy(&block[w][l], buf + w * 8, 8);
+      }
+    }
+    for (size_t w = 0; w < kRateWords; ++w) {
+      st[w] = L::Xor(st[w], L::Load(block[w]));
+    }
+    KeccakF1600<L>(st);
+    offset += kRate;
+  }
+
+  uint64_t digest[4][kLanes];
+  for (size_t w = 0; w < 4; ++w) L::Store(digest[w], st[w]);
+  for (size_t l = 0; l < kLanes; ++l) {
+    for (size_t w = 0; w < 4; ++w) memcpy(outs[l] + w * 8, &digest[w][l], 8);
+  }
+}
+
+}  // namespace details
+
+// get_msg(i) returns the i-th message, every message is len bytes.
+// out[i] is written after the group of get_msg(i) is read, so the messages
+// can live in out[j] for j >= i.
+template <typename GetMsg>
+inline void Keccak256Gather(GetMsg const& get_msg, size_t len, h256_t* out,
+                            size_t n) {
+  typedef details::Simd L;
+  constexpr size_t kLanes = L::kLanes;
+  uint8_t const* msgs[kLanes];
+  uint8_t* outs[kLanes];
+  h256_t dummy[kLanes];
+  for (size_t i = 0; i < n; i += kLanes) {
+    for (size_t l = 0; l < kLanes; ++l) {
+      if (i + l < n) {
+        msgs[l] = get_msg(i + l);
+        outs[l] = out[i + l].data();
+      } else {
+        msgs[l] = msgs[0];
+        outs[l] = dummy[l].data();
+      }
+    }
+    details::Keccak256Lanes<L>(msgs, len, outs);
+  }
+}
+
+// n contiguous messages of len bytes
+inline void Keccak256Batch(uint8_t const* in, size_t len, h256_t* out,
+                           size_t n) {
+  auto get_msg = [in, len](size_t i) { return in + i * len; };
+  Keccak256Gather(get_msg, len, out, n);
+}
+
+// out[i] = keccak256(in[2i] || in[2i+1]), same as mkl::TwoToOne(). out can be
+// in, so a tree level can be reduced in place.
+inline void HashPairs(h256_t const* in, h256_t* out, size_t n) {
+  static_assert(sizeof(h256_t) == 32, "");
+  auto get_msg = [in](size_t i) { return in[i * 2].data(); };
+  Keccak256Gather(get_msg, 64, out, n);
+}
+
+// same as HashPairs() but split into parallel chunks, out must not overlap in
+inline void ParallelHashPairs(h256_t const* in, h256_t* out, size_t n) {
+  static constexpr size_t kChunk = 1024;
+  auto chunk_count = (n + kChunk - 1) / kChunk;
+  auto parallel_f = [in, out, n](int64_t i) {
+    size_t begin = i * kChunk;
+    size_t count = std::min(kChunk, n - begin);
+    HashPairs(in + begin * 2, out + begin, count);
+  };
+  parallel::For((int64_t)chunk_count, parallel_f);
+}
+
+inline h256_t Keccak256(uint8_t const* msg, size_t len) {
+  h256_t digest;
+  uint8_t* out = digest.data();
+  details::Keccak256Lanes<details::Scalar>(&msg, len, &out);
+  return digest;
+}
+
+}  // namespace keccak
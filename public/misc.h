@@ -130,6 +130,28 @@ inline bool IsSameFile(std::string const& file1, std::string const& file2) {
   }
 }
 
+// the content of prefix_file is the beginning of file
+inline bool IsFilePrefix(std::string const& prefix_file,
+                         std::string const& file) {
+  try {
+    io::mapped_file_params params1;
+    params1.path = prefix_file;
+    params1.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view1(params1);
+
+    io::mapped_file_params params2;
+    params2.path = file;
+    params2.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view2(params2);
+
+    if (view1.size() > view2.size()) return false;
+
+    return memcmp(view1.data(), view2.data(), view1.size()) == 0;
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
 inline bool GetFileSha256(std::string const& file, h256_t& h) {
   try {
     io::mapped_file_params params;
@@ -9,7 +9,9 @@
 #include <vector>
 
 #include "basic_types.h"
+#include "keccak_batch.h"
 #include "misc.h"
+#include "parallel.h"
 #include "public.h"
 #include "tick.h"
 
@@ -261,55 +263,209 @@ inline bool VerifyRangePath(GetItem get_item, Range const& range,
   return true;
 }
 
+// GetEmptyRoots()[h] is the root of 2^h empty items
+inline std::vector<h256_t> const& GetEmptyRoots() {
+  static const std::vector<h256_t> instance = []() {
+    std::vector<h256_t> ret(64);
+    ret[0] = kEmptyH256;
+    for (size_t h = 1; h < ret.size(); ++h) {
+      TwoToOne(ret[h - 1], ret[h - 1], &ret[h]);
+    }
+    return ret;
+  }();
+  return instance;
+}
+
 inline size_t GetTreeSize(uint64_t item_count) {
   if (item_count == 1) return 1;
   return misc::Pow2UB(item_count) - 1;
 }
 
-inline Tree BuildTree(uint64_t item_count, GetItem const& get_item) {
-  std::vector<h256_t> digests;
+namespace details {
+inline constexpr uint64_t kPairChunk = 1024;
+
+// out[i - begin] = TwoToOne(item(2i), item(2i+1)) for i in [begin, end), the
+// items past item_count are empty.
+inline void HashItemPairs(GetItem const& get_item, uint64_t item_count,
+                          uint64_t begin, uint64_t end, h256_t* out) {
+  std::vector<h256_t> items(std::min(end - begin, kPairChunk) * 2);
+  for (uint64_t i = begin; i < end; i += kPairChunk) {
+    uint64_t count = std::min(kPairChunk, end - i);
+    for (uint64_t j = 0; j < count * 2; ++j) {
+      uint64_t k = i * 2 + j;
+      items[j] = k < item_count ? get_item(k) : kEmptyH256;
+    }
+    keccak::HashPairs(items.data(), out + (i - begin), count);
+  }
+}
+}  // namespace details
+
+// Write the GetTreeSize(item_count) nodes to tree, which can point into a
+// mapped file as well as a vector.
+inline void BuildTree(uint64_t item_count, GetItem const& get_item,
+                      h256_t* tree) {
   if (item_count == 1) {
-    digests.push_back(get_item(0));
-    return digests;
+    tree[0] = get_item(0);
+    return;
   }
 
   auto align_count = misc::Pow2UB(item_count);
   auto depth = misc::Log2UB(item_count);
-  digests.reserve(align_count - 1);
 
-  auto get_item_or_empty = [item_count, &get_item](uint64_t i) -> h256_t {
-    if (i >= item_count) return kEmptyH256;
-    return get_item(i);
-  };
+  details::HashItemPairs(get_item, item_count, 0, align_count / 2, tree);
 
-  for (uint64_t i = 0; i < align_count / 2; ++i) {
-    auto left = get_item_or_empty(i * 2);
-    auto right = get_item_or_empty(i * 2 + 1);
-    digests.resize(digests.size() + 1);
-    TwoToOne(left, right, &digests.back());
+  uint64_t pos = align_count / 2;
+  for (uint64_t i = 1; i < depth; ++i) {
+    uint64_t length = 1ULL << (depth - i);
+    keccak::HashPairs(tree + pos - length, tree + pos, length / 2);
+    pos += length / 2;
   }
 
+  assert(pos == (align_count - 1));
+}
+
+inline Tree BuildTree(uint64_t item_count, GetItem const& get_item) {
+  Tree tree(GetTreeSize(item_count));
+  BuildTree(item_count, get_item, tree.data());
+  return tree;
+}
+
+// Same result as BuildTree(), every level is hashed in parallel. get_item must
+// be thread safe.
+inline void ParallelBuildTree(uint64_t item_count, GetItem const& get_item,
+                              h256_t* tree) {
+  using details::kPairChunk;
+  if (item_count == 1) {
+    tree[0] = get_item(0);
+    return;
+  }
+
+  auto align_count = misc::Pow2UB(item_count);
+  auto depth = misc::Log2UB(item_count);
+
+  uint64_t pair_count = align_count / 2;
+  auto parallel_f = [tree, &get_item, item_count, pair_count](int64_t i) {
+    uint64_t begin = i * kPairChunk;
+    uint64_t end = std::min(begin + kPairChunk, pair_count);
+    details::HashItemPairs(get_item, item_count, begin, end, tree + begin);
+  };
+  parallel::For((int64_t)((pair_count + kPairChunk - 1) / kPairChunk),
+                parallel_f);
+
+  uint64_t pos = pair_count;
   for (uint64_t i = 1; i < depth; ++i) {
     uint64_t length = 1ULL << (depth - i);
-    uint64_t offset = digests.size() - length;
-    for (uint64_t j = 0; j < length / 2; ++j) {
-      digests.resize(digests.size() + 1);
-      TwoToOne(digests[offset + j * 2], digests[offset + j * 2 + 1],
-               &digests.back());
+    keccak::ParallelHashPairs(tree + pos - length, tree + pos, length / 2);
+    pos += length / 2;
+  }
+
+  assert(pos == (align_count - 1));
+}
+
+inline Tree ParallelBuildTree(uint64_t item_count, GetItem const& get_item) {
+  Tree tree(GetTreeSize(item_count));
+  ParallelBuildTree(item_count, get_item, tree.data());
+  return tree;
+}
+
+// Same result as ParallelBuildTree(item_count, get_item, tree), but the nodes
+// which only cover the first same_count items are copied from the old tree of
+// old_item_count items, get_old_node(i) returns its i-th node. Only the new
+// items and their ancestors are hashed, the nodes which only cover the
+// padding are the roots of the empty subtrees.
+inline void ExtendTree(uint64_t old_item_count, GetItem const& get_old_node,
+                       uint64_t same_count, uint64_t item_count,
+                       GetItem const& get_item, h256_t* tree) {
+  using details::kPairChunk;
+  assert(same_count <= old_item_count && same_count <= item_count);
+  if (item_count == 1) {
+    tree[0] = get_item(0);
+    return;
+  }
+
+  auto align_count = misc::Pow2UB(item_count);
+  auto depth = misc::Log2UB(item_count);
+  auto old_align_count = misc::Pow2UB(old_item_count);
+
+  uint64_t pos = 0;
+  for (uint64_t level = 1; level <= depth; ++level) {
+    uint64_t length = align_count >> level;
+    uint64_t keep = same_count >> level;
+    // the nodes past used only cover the padding
+    uint64_t used = ((item_count - 1) >> level) + 1;
+    uint64_t old_pos = old_align_count - (old_align_count >> (level - 1));
+    for (uint64_t i = 0; i < keep; ++i) {
+      tree[pos + i] = get_old_node(old_pos + i);
+    }
+
+    if (level == 1) {
+      auto parallel_f = [tree, &get_item, item_count, keep, used](int64_t i) {
+        uint64_t begin = keep + i * kPairChunk;
+        uint64_t end = std::min(begin + kPairChunk, used);
+        details::HashItemPairs(get_item, item_count, begin, end, tree + begin);
+      };
+      parallel::For((int64_t)((used - keep + kPairChunk - 1) / kPairChunk),
+                    parallel_f);
+    } else {
+      // the lower level is the 2 * length nodes just before pos
+      h256_t const* lower = tree + pos - length * 2;
+      keccak::ParallelHashPairs(lower + keep * 2, tree + pos + keep,
+                                used - keep);
     }
+    std::fill(tree + pos + used, tree + pos + length, GetEmptyRoots()[level]);
+    pos += length;
   }
 
-  assert(digests.size() == (align_count - 1));
-  return digests;
+  assert(pos == (align_count - 1));
+}
+
+inline Tree ExtendTree(uint64_t old_item_count, GetItem const& get_old_node,
+                       uint64_t same_count, uint64_t item_count,
+                       GetItem const& get_item) {
+  Tree tree(GetTreeSize(item_count));
+  ExtendTree(old_item_count, get_old_node, same_count, item_count, get_item,
+             tree.data());
+  return tree;
+}
+
+// Same result as CalcRoot() without allocating the tree: the leaves are split
+// into aligned power of 2 subtrees, their roots are calculated in parallel and
+// then merged. get_item must be thread safe.
+inline h256_t ParallelCalcRoot(GetItem const& get_item, uint64_t item_count) {
+  constexpr uint64_t kMaxSubtreeSize = 64 * 1024;
+  uint64_t align_count = misc::Pow2UB(item_count);
+  uint64_t subtree_count =
+      misc::Pow2UB(std::max(1U, std::thread::hardware_concurrency()) * 4);
+  subtree_count = std::max(subtree_count, align_count / kMaxSubtreeSize);
+  if (align_count < subtree_count * 2) return CalcRoot(get_item, item_count);
+
+  uint64_t subtree_size = align_count / subtree_count;
+  std::vector<h256_t> roots(subtree_count);
+  auto parallel_f = [&get_item, item_count, subtree_size,
+                     &roots](int64_t i) {
+    uint64_t begin = i * subtree_size / 2;
+    uint64_t end = begin + subtree_size / 2;
+    std::vector<h256_t> nodes(subtree_size / 2);
+    details::HashItemPairs(get_item, item_count, begin, end, nodes.data());
+    for (uint64_t count = nodes.size(); count > 1; count /= 2) {
+      keccak::HashPairs(nodes.data(), nodes.data(), count / 2);
+    }
+    roots[i] = nodes[0];
+  };
+  parallel::For((int64_t)subtree_count, parallel_f);
+
+  for (uint64_t count = subtree_count; count > 1; count /= 2) {
+    keccak::HashPairs(roots.data(), roots.data(), count / 2);
+  }
+  return roots[0];
 }
 
+// get_node(i) returns the i-th node of the tree built by BuildTree(), so the
+// tree can live anywhere (vector, mapped file...).
 inline Path GetRangePath(uint64_t item_count, GetItem const& get_item,
-                         Tree const& tree, Range const& range) {
+                         GetItem const& get_node, Range const& range) {
   std::vector<h256_t> path;
-  if (tree.size() != GetTreeSize(item_count))
-    throw std::runtime_error("invaild parameters");
-
-  if (tree.size() == 1) return path;  // empty
+  if (item_count == 1) return path;  // empty
 
   auto align_count = misc::Pow2UB(item_count);
   auto depth = misc::Log2UB(item_count);
@@ -344,14 +500,267 @@ inline Path GetRangePath(uint64_t item_count, GetItem const& get_item,
         path.push_back(get_item_or_empty(brother));
       } else {
         auto offset = get_offset(i - 1, brother);
-        path.push_back(tree[offset]);
+        path.push_back(get_node(offset));
       }
       leaf /= 2;
     }
   }
 
-  assert(VerifyRangePath(get_item, range, item_count, tree.back(), path));
+  assert(VerifyRangePath(get_item, range, item_count,
+                         get_node(GetTreeSize(item_count) - 1), path));
   return path;
 }
 
+inline Path GetRangePath(uint64_t item_count, GetItem const& get_item,
+                         Tree const& tree, Range const& range) {
+  if (tree.size() != GetTreeSize(item_count))
+    throw std::runtime_error("invaild parameters");
+
+  auto get_node = [&tree](uint64_t i) -> h256_t { return tree[i]; };
+  return GetRangePath(item_count, get_item, get_node, range);
+}
+
+// Proof of several leaves at once. A sibling is only included when it can not
+// be computed from the proven leaves, so the paths share their upper nodes.
+struct MultiProof {
+  std::vector<uint64_t> leaves;  // sorted, no duplicate
+  std::vector<h256_t> nodes;     // level by level, left to right
+};
+
+inline bool operator==(MultiProof const& a, MultiProof const& b) {
+  return a.leaves == b.leaves && a.nodes == b.nodes;
+}
+
+inline bool operator!=(MultiProof const& a, MultiProof const& b) {
+  return !(a == b);
+}
+
+// items[i] is the leaf proof.leaves[i]
+inline bool VerifyMultiProof(uint64_t item_count, h256_t const& root,
+                             MultiProof const& proof,
+                             std::vector<h256_t> const& items) {
+  auto const& leaves = proof.leaves;
+  if (leaves.empty() || items.size() != leaves.size()) return false;
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    if (leaves[i] >= item_count) return false;
+    if (i && leaves[i] <= leaves[i - 1]) return false;
+  }
+
+  if (item_count == 1) return proof.nodes.empty() && items[0] == root;
+
+  auto depth = misc::Log2UB(item_count);
+  std::vector<uint64_t> indexes = leaves;
+  std::vector<h256_t> values = items;
+  std::vector<h256_t> pairs;
+  size_t node_pos = 0;
+  for (uint64_t level = 0; level < depth; ++level) {
+    pairs.clear();
+    size_t count = 0;
+    for (size_t i = 0; i < indexes.size(); ++i) {
+      uint64_t index = indexes[i];
+      if (index % 2 == 0 && i + 1 < indexes.size() &&
+          indexes[i + 1] == index + 1) {
+        pairs.push_back(values[i]);
+        pairs.push_back(values[++i]);
+      } else {
+        if (node_pos >= proof.nodes.size()) return false;
+        auto const& brother = proof.nodes[node_pos++];
+        if (index % 2 == 0) {
+          pairs.push_back(values[i]);
+          pairs.push_back(brother);
+        } else {
+          pairs.push_back(brother);
+          pairs.push_back(values[i]);
+        }
+      }
+      indexes[count++] = index / 2;
+    }
+    indexes.resize(count);
+    values.resize(count);
+    keccak::HashPairs(pairs.data(), values.data(), count);
+  }
+
+  if (node_pos != proof.nodes.size()) return false;
+  assert(indexes.size() == 1 && indexes[0] == 0);
+  return values[0] == root;
+}
+
+// get_node(i) returns the i-th node of the tree built by BuildTree().
+inline MultiProof GetMultiProof(uint64_t item_count, GetItem const& get_item,
+                                GetItem const& get_node,
+                                std::vector<uint64_t> leaves) {
+  std::sort(leaves.begin(), leaves.end());
+  leaves.erase(std::unique(leaves.begin(), leaves.end()), leaves.end());
+  assert(!leaves.empty() && leaves.back() < item_count);
+
+  MultiProof proof;
+  if (item_count == 1) {
+    proof.leaves = std::move(leaves);
+    return proof;
+  }
+
+  auto align_count = misc::Pow2UB(item_count);
+  auto depth = misc::Log2UB(item_count);
+
+  // level 0 is the items, level i (i>0) starts at align_count - 2^(depth-i+1)
+  auto get_level_node = [&](uint64_t level, uint64_t index) -> h256_t {
+    if (level == 0) return index < item_count ? get_item(index) : kEmptyH256;
+    uint64_t offset = align_count - (align_count >> (level - 1));
+    return get_node(offset + index);
+  };
+
+  std::vector<uint64_t> indexes = leaves;
+  for (uint64_t level = 0; level < depth; ++level) {
+    size_t count = 0;
+    for (size_t i = 0; i < indexes.size(); ++i) {
+      uint64_t index = indexes[i];
+      if (index % 2 == 0 && i + 1 < indexes.size() &&
+          indexes[i + 1] == index + 1) {
+        ++i;
+      } else {
+        proof.nodes.push_back(get_level_node(level, index ^ 1));
+      }
+      indexes[count++] = index / 2;
+    }
+    indexes.resize(count);
+  }
+  proof.leaves = std::move(leaves);
+
+#ifdef _DEBUG
+  std::vector<h256_t> items(proof.leaves.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    items[i] = get_item(proof.leaves[i]);
+  }
+  assert(VerifyMultiProof(item_count, get_node(GetTreeSize(item_count) - 1),
+                          proof, items));
+#endif
+  return proof;
+}
+
+inline MultiProof GetMultiProof(uint64_t item_count, GetItem const& get_item,
+                                Tree const& tree,
+                                std::vector<uint64_t> leaves) {
+  if (tree.size() != GetTreeSize(item_count))
+    throw std::runtime_error("invaild parameters");
+
+  auto get_node = [&tree](uint64_t i) -> h256_t { return tree[i]; };
+  return GetMultiProof(item_count, get_item, get_node, std::move(leaves));
+}
+
+// Read-only view of a tree file saved by SaveMkl(). The file is mapped and the
+// nodes are read on demand, so it can replace a loaded Tree when only some
+// paths are needed.
+class TreeView {
+ public:
+  TreeView() {}
+
+  TreeView(std::string const& file, uint64_t item_count) {
+    if (!Open(file, item_count)) throw std::runtime_error("invalid tree file");
+  }
+
+  bool Open(std::string const& file, uint64_t item_count) {
+    try {
+      io::mapped_file_params params;
+      params.path = file;
+      params.flags = io::mapped_file_base::readonly;
+      auto view = std::make_shared<io::mapped_file_source>(params);
+      auto tree_size = GetTreeSize(item_count);
+      if (view->size() != tree_size * kItemSize) return false;
+      view_ = std::move(view);
+      item_count_ = item_count;
+      size_ = tree_size;
+      return true;
+    } catch (std::exception&) {
+      return false;
+    }
+  }
+
+  bool empty() const { return size_ == 0; }
+
+  size_t size() const { return size_; }
+
+  uint64_t item_count() const { return item_count_; }
+
+  h256_t operator[](size_t i) const {
+    assert(i < size_);
+    h256_t h;
+    memcpy(h.data(), view_->data() + i * kItemSize, kItemSize);
+    return h;
+  }
+
+  h256_t back() const { return (*this)[size_ - 1]; }
+
+  h256_t root() const { return back(); }
+
+  Path GetRangePath(GetItem const& get_item, Range const& range) const {
+    auto get_node = [this](uint64_t i) -> h256_t { return (*this)[i]; };
+    return mkl::GetRangePath(item_count_, get_item, get_node, range);
+  }
+
+  Path GetPath(GetItem const& get_item, uint64_t leaf) const {
+    return GetRangePath(get_item, Range(leaf, 1));
+  }
+
+  MultiProof GetMultiProof(GetItem const& get_item,
+                           std::vector<uint64_t> leaves) const {
+    auto get_node = [this](uint64_t i) -> h256_t { return (*this)[i]; };
+    return mkl::GetMultiProof(item_count_, get_item, get_node,
+                              std::move(leaves));
+  }
+
+ private:
+  static constexpr size_t kItemSize = 32;  // h256_t
+  std::shared_ptr<io::mapped_file_source> view_;
+  uint64_t item_count_ = 0;
+  size_t size_ = 0;
+};
+
+// the multiproof of some leaves verifies, a changed item does not, and the
+// multiproof of one leaf is its path
+inline bool TestMultiProof(uint64_t item_count) {
+  std::vector<h256_t> items(item_count);
+  for (auto& i : items) i = misc::RandH256();
+  auto get_item = [&items](uint64_t i) { return items[i]; };
+  auto tree = BuildTree(item_count, get_item);
+
+  // pairs of brothers and gaps
+  std::vector<uint64_t> leaves;
+  for (uint64_t i = 0; i < item_count; i += 1 + i % 5) leaves.push_back(i);
+  auto proof = GetMultiProof(item_count, get_item, tree, leaves);
+  std::vector<h256_t> proven(proof.leaves.size());
+  for (size_t i = 0; i < proven.size(); ++i) {
+    proven[i] = items[proof.leaves[i]];
+  }
+  if (!VerifyMultiProof(item_count, tree.back(), proof, proven)) return false;
+
+  proven.back()[0] ^= 1;
+  if (VerifyMultiProof(item_count, tree.back(), proof, proven)) return false;
+
+  if (item_count == 1) return true;
+  uint64_t leaf = item_count / 2;
+  auto single = GetMultiProof(item_count, get_item, tree, {leaf});
+  return single.nodes ==
+         GetRangePath(item_count, get_item, tree, Range(leaf, 1));
+}
+
+// ExtendTree() of the old tree gives the tree built over the new items, the
+// first same_count items are the same in both
+inline bool TestExtendTree(uint64_t old_item_count, uint64_t same_count,
+                           uint64_t item_count) {
+  assert(same_count <= old_item_count && same_count <= item_count);
+  std::vector<h256_t> items(item_count);
+  for (auto& i : items) i = misc::RandH256();
+  std::vector<h256_t> old_items(old_item_count);
+  for (uint64_t i = 0; i < old_item_count; ++i) {
+    old_items[i] = i < same_count ? items[i] : misc::RandH256();
+  }
+  auto get_item = [&items](uint64_t i) { return items[i]; };
+  auto get_old_item = [&old_items](uint64_t i) { return old_items[i]; };
+  auto old_tree = BuildTree(old_item_count, get_old_item);
+  auto get_old_node = [&old_tree](uint64_t i) { return old_tree[i]; };
+  auto tree = ExtendTree(old_item_count, get_old_node, same_count, item_count,
+                         get_item);
+  return tree == BuildTree(item_count, get_item);
+}
+
 }  // namespace mkl
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "basic_types_serialize.h"
+#include "mkl_tree.h"
+
+namespace mkl {
+// save
+template <typename Ar>
+void serialize(Ar &ar, MultiProof const &t) {
+  ar &YAS_OBJECT_NVP("MultiProof", ("l", t.leaves), ("n", t.nodes));
+}
+
+// load
+template <typename Ar>
+void serialize(Ar &ar, MultiProof &t) {
+  ar &YAS_OBJECT_NVP("MultiProof", ("l", t.leaves), ("n", t.nodes));
+}
+}  // namespace mkl
@@ -137,6 +137,16 @@ inline bool LoadMkl(std::string const& input, uint64_t n,
   }
 }
 
+// map the tree file instead of copying it
+inline bool LoadMkl(std::string const& input, uint64_t n,
+                    mkl::TreeView& mkl_tree) {
+  if (!mkl_tree.Open(input, n)) {
+    assert(false);
+    return false;
+  }
+  return true;
+}
+
 inline bool SaveSigma(std::string const& output, std::vector<G1> const& sigma) {
   Tick _tick_(__FUNCTION__);
   try {
@@ -174,7 +184,7 @@ inline bool LoadSigma(std::string const& input, uint64_t n, h256_t const* root,
         memcpy(h.data(), start + i * kG1CompBinSize, kG1CompBinSize);
         return h;
       };
-      if (*root != mkl::CalcRoot(std::move(get_sigma), n)) {
+      if (*root != mkl::ParallelCalcRoot(get_sigma, n)) {
         assert(false);
         return false;
       }
@@ -193,6 +203,265 @@ inline bool LoadSigma(std::string const& input, uint64_t n, h256_t const* root,
   }
 }
 
+// sigma_affine file: header + n * (x, y) in the native (montgomery) layout of
+// Fp, so the load is only a memcpy. A zero sigma is saved as x = y = 0, which
+// is not on the curve. The sigma mkl tree is still built over the compressed
+// encoding (G1ToBin), which is cheap to derive from x and y.
+namespace details {
+struct SigmaAffineHeader {
+  char magic[8];
+  uint64_t n;
+  uint64_t fp_size;
+};
+
+inline static const char kSigmaAffineMagic[8] = {'S', 'I', 'G', 'M',
+                                                 'A', 'A', 'F', '1'};
+}  // namespace details
+
+inline uint64_t GetSigmaAffineFileSize(uint64_t n) {
+  return sizeof(details::SigmaAffineHeader) + n * sizeof(Fp) * 2;
+}
+
+inline bool SaveSigmaAffine(std::string const& output,
+                            std::vector<G1> const& sigmas) {
+  Tick _tick_(__FUNCTION__);
+  try {
+    io::mapped_file_params params;
+    params.path = output;
+    params.flags = io::mapped_file_base::readwrite;
+    params.new_file_size = GetSigmaAffineFileSize(sigmas.size());
+    io::mapped_file view(params);
+    uint8_t* start = (uint8_t*)view.data();
+
+    details::SigmaAffineHeader header;
+    memcpy(header.magic, details::kSigmaAffineMagic, sizeof(header.magic));
+    header.n = sigmas.size();
+    header.fp_size = sizeof(Fp);
+    memcpy(start, &header, sizeof(header));
+    start += sizeof(header);
+
+    auto parallel_f = [start, &sigmas](int64_t i) {
+      uint8_t* p = start + i * sizeof(Fp) * 2;
+      G1 sigma = sigmas[i];
+      if (sigma.isZero()) {
+        memset(p, 0, sizeof(Fp) * 2);
+        return;
+      }
+      sigma.normalize();
+      memcpy(p, &sigma.x, sizeof(Fp));
+      memcpy(p + sizeof(Fp), &sigma.y, sizeof(Fp));
+    };
+    parallel::For((int64_t)sigmas.size(), parallel_f);
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
+// If root is not null, every point is checked on the curve and the mkl root is
+// recomputed over the compressed encodings. The curve check matters: the
+// compressed bytes only bind x and the parity of y.
+inline bool LoadSigmaAffine(std::string const& input, uint64_t n,
+                            h256_t const* root, std::vector<G1>& sigmas) {
+  Tick _tick_(__FUNCTION__);
+  try {
+    io::mapped_file_params params;
+    params.path = input;
+    params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view(params);
+    if (view.size() != GetSigmaAffineFileSize(n)) return false;
+    auto start = (uint8_t const*)view.data();
+
+    details::SigmaAffineHeader header;
+    memcpy(&header, start, sizeof(header));
+    if (memcmp(header.magic, details::kSigmaAffineMagic,
+               sizeof(header.magic)) ||
+        header.n != n || header.fp_size != sizeof(Fp)) {
+      assert(false);
+      return false;
+    }
+    start += sizeof(header);
+
+    sigmas.resize(n);
+    std::vector<int64_t> rets(n);
+    bool check = root != nullptr;
+    auto parallel_f = [start, check, &sigmas, &rets](int64_t i) mutable {
+      uint8_t const* p = start + i * sizeof(Fp) * 2;
+      G1& sigma = sigmas[i];
+      memcpy(&sigma.x, p, sizeof(Fp));
+      memcpy(&sigma.y, p + sizeof(Fp), sizeof(Fp));
+      if (sigma.x.isZero() && sigma.y.isZero()) {
+        sigma.clear();
+      } else {
+        sigma.z = 1;
+      }
+      rets[i] = !check || sigma.isValid();
+    };
+    parallel::For((int64_t)n, parallel_f);
+
+    if (std::any_of(rets.begin(), rets.end(), [](int64_t r) { return !r; })) {
+      assert(false);
+      return false;
+    }
+
+    if (root) {
+      std::vector<h256_t> bins(n);
+      auto parallel_bin = [&sigmas, &bins](int64_t i) {
+        bins[i] = G1ToBin(sigmas[i]);
+      };
+      parallel::For((int64_t)n, parallel_bin);
+      auto get_sigma = [&bins](uint64_t i) -> h256_t { return bins[i]; };
+      if (*root != mkl::ParallelCalcRoot(get_sigma, n)) {
+        assert(false);
+        return false;
+      }
+    }
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
+// Convert the compressed sigma file of a publication to the affine layout.
+inline bool ConvertSigmaToAffine(std::string const& sigma_file,
+                                 std::string const& sigma_affine_file,
+                                 uint64_t n, h256_t const& root) {
+  Tick _tick_(__FUNCTION__);
+  std::vector<G1> sigmas;
+  if (!LoadSigma(sigma_file, n, &root, sigmas)) {
+    assert(false);
+    return false;
+  }
+  return SaveSigmaAffine(sigma_affine_file, sigmas);
+}
+
+// Load public/sigma_affine if it exists, otherwise fall back to public/sigma.
+inline bool LoadSigmaAny(std::string const& public_path, uint64_t n,
+                         h256_t const* root, std::vector<G1>& sigmas) {
+  std::string sigma_affine_file = public_path + "/sigma_affine";
+  boost::system::error_code err;
+  if (fs::is_regular_file(sigma_affine_file, err)) {
+    return LoadSigmaAffine(sigma_affine_file, n, root, sigmas);
+  }
+  return LoadSigma(public_path + "/sigma", n, root, sigmas);
+}
+
+// Demand mode: only read and decompress the sigmas in ranges. The ranges are
+// verified against root with a multiproof read from sigma_mkl_tree, so
+// the cost is O(count * log(n)) instead of O(n). The output is in the order of
+// ranges.
+inline bool LoadSigmaRanges(std::string const& public_path, uint64_t n,
+                            h256_t const& root,
+                            std::vector<Range> const& ranges,
+                            std::vector<G1>& sigmas) {
+  Tick _tick_(__FUNCTION__);
+  std::string sigma_file = public_path + "/sigma";
+  std::string sigma_affine_file = public_path + "/sigma_affine";
+  std::string sigma_mkl_tree_file = public_path + "/sigma_mkl_tree";
+  try {
+    boost::system::error_code err;
+    bool affine = fs::is_regular_file(sigma_affine_file, err);
+
+    io::mapped_file_params params;
+    params.path = affine ? sigma_affine_file : sigma_file;
+    params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view(params);
+    auto start = (uint8_t const*)view.data();
+    if (affine) {
+      if (view.size() != GetSigmaAffineFileSize(n)) return false;
+      start += sizeof(details::SigmaAffineHeader);
+    } else {
+      if (view.size() != n * kG1CompBinSize) return false;
+    }
+
+    mkl::TreeView tree;
+    if (!tree.Open(sigma_mkl_tree_file, n)) return false;
+
+    auto get_sigma = [start, affine, n](uint64_t i, G1* sigma) -> bool {
+      assert(i < n);
+      (void)n;
+      if (!affine) return BinToG1(start + i * kG1CompBinSize, sigma);
+      uint8_t const* p = start + i * sizeof(Fp) * 2;
+      memcpy(&sigma->x, p, sizeof(Fp));
+      memcpy(&sigma->y, p + sizeof(Fp), sizeof(Fp));
+      if (sigma->x.isZero() && sigma->y.isZero()) {
+        sigma->clear();
+        return true;
+      }
+      sigma->z = 1;
+      return sigma->isValid();
+    };
+
+    // the leaf is the compressed encoding, for affine file derive it from x,y
+    auto get_item = [start, affine, n](uint64_t i) -> h256_t {
+      assert(i < n);
+      (void)n;
+      h256_t h;
+      if (affine) {
+        uint8_t const* p = start + i * sizeof(Fp) * 2;
+        G1 sigma;
+        memcpy(&sigma.x, p, sizeof(Fp));
+        memcpy(&sigma.y, p + sizeof(Fp), sizeof(Fp));
+        if (sigma.x.isZero() && sigma.y.isZero()) {
+          sigma.clear();
+        } else {
+          sigma.z = 1;
+        }
+        G1ToBin(sigma, h.data());
+      } else {
+        memcpy(h.data(), start + i * kG1CompBinSize, kG1CompBinSize);
+      }
+      return h;
+    };
+
+    uint64_t count = 0;
+    for (auto const& range : ranges) {
+      if (!range.count || range.start >= n || range.start + range.count > n)
+        return false;
+      count += range.count;
+    }
+
+    std::vector<uint64_t> indexes;
+    indexes.reserve(count);
+    for (auto const& range : ranges) {
+      for (uint64_t i = range.start; i < range.start + range.count; ++i)
+        indexes.push_back(i);
+    }
+
+    // one multiproof for all of the demands, the ranges share their nodes
+    auto proof = tree.GetMultiProof(get_item, indexes);
+    std::vector<h256_t> items(proof.leaves.size());
+    auto parallel_f = [&proof, &items, &get_item](int64_t i) {
+      items[i] = get_item(proof.leaves[i]);
+    };
+    parallel::For((int64_t)items.size(), parallel_f);
+    if (!mkl::VerifyMultiProof(n, root, proof, items)) {
+      assert(false);
+      return false;
+    }
+
+    sigmas.resize(count);
+    std::vector<int64_t> sigma_rets(count);
+    auto parallel_g = [&sigmas, &indexes, &sigma_rets,
+                       &get_sigma](int64_t i) {
+      sigma_rets[i] = get_sigma(indexes[i], &sigmas[i]);
+    };
+    parallel::For((int64_t)count, parallel_g);
+
+    if (std::any_of(sigma_rets.begin(), sigma_rets.end(),
+                    [](int64_t r) { return !r; })) {
+      assert(false);
+      return false;
+    }
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
 inline bool SaveMatrix(std::string const& output, std::vector<Fr> const& m) {
   Tick _tick_(__FUNCTION__);
   try {
@@ -202,9 +471,10 @@ inline bool SaveMatrix(std::string const& output, std::vector<Fr> const& m) {
     params.new_file_size = m.size() * kFrBinSize;
     io::mapped_file view(params);
     uint8_t* start = (uint8_t*)view.data();
-    for (size_t i = 0; i < m.size(); ++i) {
+    auto parallel_f = [start, &m](int64_t i) {
       FrToBin(m[i], start + i * kFrBinSize);
-    }
+    };
+    parallel::For((int64_t)m.size(), parallel_f);
     return true;
   } catch (std::exception&) {
     assert(false);
@@ -257,7 +527,100 @@ inline std::vector<h256_t> BuildSigmaMklTree(std::vector<G1> const& sigmas) {
   auto get_sigma = [&sigmas](uint64_t i) -> h256_t {
     return G1ToBin(sigmas[i]);
   };
-  return mkl::BuildTree(sigmas.size(), get_sigma);
+  return mkl::ParallelBuildTree(sigmas.size(), get_sigma);
+}
+
+// Build the tree of a saved sigma file straight into the output file, neither
+// the sigmas nor the tree are loaded.
+inline bool BuildSigmaMklTreeFile(std::string const& sigma_file, uint64_t n,
+                                  std::string const& output, h256_t* root) {
+  Tick _tick_(__FUNCTION__);
+  constexpr size_t kItemSize = 32;  // h256_t
+  static_assert(kG1CompBinSize == kItemSize, "");
+  try {
+    io::mapped_file_params sigma_params;
+    sigma_params.path = sigma_file;
+    sigma_params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source sigma_view(sigma_params);
+    if (sigma_view.size() != n * kG1CompBinSize) {
+      assert(false);
+      return false;
+    }
+    auto sigma_start = (uint8_t const*)sigma_view.data();
+
+    io::mapped_file_params params;
+    params.path = output;
+    params.flags = io::mapped_file_base::readwrite;
+    params.new_file_size = mkl::GetTreeSize(n) * kItemSize;
+    io::mapped_file view(params);
+    auto tree = (h256_t*)view.data();
+
+    auto get_sigma = [sigma_start](uint64_t i) -> h256_t {
+      h256_t h;
+      memcpy(h.data(), sigma_start + i * kG1CompBinSize, kG1CompBinSize);
+      return h;
+    };
+    mkl::ParallelBuildTree(n, get_sigma, tree);
+    *root = tree[mkl::GetTreeSize(n) - 1];
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
+// Same output as BuildSigmaMklTreeFile(), the nodes which only cover the first
+// same_count sigmas are copied from old_tree_file, the tree of old_n sigmas.
+inline bool ExtendSigmaMklTreeFile(std::string const& old_tree_file,
+                                   uint64_t old_n, uint64_t same_count,
+                                   std::string const& sigma_file, uint64_t n,
+                                   std::string const& output, h256_t* root) {
+  Tick _tick_(__FUNCTION__);
+  constexpr size_t kItemSize = 32;  // h256_t
+  static_assert(kG1CompBinSize == kItemSize, "");
+  if (same_count > old_n || same_count > n) {
+    assert(false);
+    return false;
+  }
+  try {
+    mkl::TreeView old_tree;
+    if (!LoadMkl(old_tree_file, old_n, old_tree)) {
+      assert(false);
+      return false;
+    }
+
+    io::mapped_file_params sigma_params;
+    sigma_params.path = sigma_file;
+    sigma_params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source sigma_view(sigma_params);
+    if (sigma_view.size() != n * kG1CompBinSize) {
+      assert(false);
+      return false;
+    }
+    auto sigma_start = (uint8_t const*)sigma_view.data();
+
+    io::mapped_file_params params;
+    params.path = output;
+    params.flags = io::mapped_file_base::readwrite;
+    params.new_file_size = mkl::GetTreeSize(n) * kItemSize;
+    io::mapped_file view(params);
+    auto tree = (h256_t*)view.data();
+
+    auto get_sigma = [sigma_start](uint64_t i) -> h256_t {
+      h256_t h;
+      memcpy(h.data(), sigma_start + i * kG1CompBinSize, kG1CompBinSize);
+      return h;
+    };
+    auto get_old_node = [&old_tree](uint64_t i) -> h256_t {
+      return old_tree[i];
+    };
+    mkl::ExtendTree(old_n, get_old_node, same_count, n, get_sigma, tree);
+    *root = tree[mkl::GetTreeSize(n) - 1];
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
 }
 
 inline bool GetBulletinMode(std::string const& file, Mode& mode) {
@@ -279,27 +642,116 @@ inline bool GetBulletinMode(std::string const& file, Mode& mode) {
   }
 }
 
-inline bool IsElementUnique(std::vector<Fr> const v) {
-  std::vector<Fr const*> pv(v.size());
-  for (size_t i = 0; i < v.size(); ++i) pv[i] = &v[i];
+namespace details {
+// mix the raw limbs, the equal Fr have the same limbs
+inline uint64_t FrFingerprint(Fr const& f) {
+  mcl::fp::Unit const* p = f.getUnit();
+  uint64_t h = 0;
+  for (size_t i = 0; i < Fr::getUnitSize(); ++i) {
+    h = (h ^ (uint64_t)p[i]) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+  }
+  return h;
+}
+}  // namespace details
 
-  auto compare = [](Fr const* a, Fr const* b) {
-    return a->getMpz() < b->getMpz();
+// The elements are partitioned by the high bits of their fingerprints in
+// parallel, then every bucket is sorted and the equal fingerprints are
+// compared by value.
+inline bool IsElementUnique(std::vector<Fr> const& v) {
+  Tick _tick_(__FUNCTION__);
+  uint64_t n = v.size();
+  if (n < 2) return true;
+
+  static constexpr uint64_t kBucketBits = 8;
+  static constexpr uint64_t kBucketCount = 1ULL << kBucketBits;
+  uint64_t chunk_size = std::max<uint64_t>(
+      64 * 1024, n / (std::max(1U, std::thread::hardware_concurrency()) * 4));
+  uint64_t chunk_count = (n + chunk_size - 1) / chunk_size;
+
+  std::vector<uint64_t> h(n);
+  std::vector<uint64_t> counts(chunk_count * kBucketCount);
+  auto hash_f = [&v, &h, &counts, n, chunk_size](int64_t c) {
+    uint64_t* count = &counts[c * kBucketCount];
+    for (uint64_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size);
+         ++i) {
+      h[i] = details::FrFingerprint(v[i]);
+      ++count[h[i] >> (64 - kBucketBits)];
+    }
+  };
+  parallel::For((int64_t)chunk_count, hash_f);
+
+  // counts become the write positions, bucket b is [bucket[b], bucket[b+1])
+  std::vector<uint64_t> bucket(kBucketCount + 1);
+  uint64_t pos = 0;
+  for (uint64_t b = 0; b < kBucketCount; ++b) {
+    bucket[b] = pos;
+    for (uint64_t c = 0; c < chunk_count; ++c) {
+      auto count = counts[c * kBucketCount + b];
+      counts[c * kBucketCount + b] = pos;
+      pos += count;
+    }
+  }
+  bucket[kBucketCount] = pos;
+
+  // (fingerprint, index)
+  std::vector<std::pair<uint64_t, uint64_t>> items(n);
+  auto scatter_f = [&h, &counts, &items, n, chunk_size](int64_t c) {
+    uint64_t* offset = &counts[c * kBucketCount];
+    for (uint64_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size);
+         ++i) {
+      items[offset[h[i] >> (64 - kBucketBits)]++] = std::make_pair(h[i], i);
+    }
+  };
+  parallel::For((int64_t)chunk_count, scatter_f);
+  std::vector<uint64_t>().swap(h);
+
+  std::vector<uint8_t> unique(kBucketCount);
+  auto check_f = [&v, &items, &bucket, &unique](int64_t b) {
+    auto begin = items.begin() + bucket[b];
+    auto end = items.begin() + bucket[b + 1];
+    std::sort(begin, end);
+    for (auto i = begin; i != end; ++i) {
+      for (auto j = i + 1; j != end && j->first == i->first; ++j) {
+        if (v[i->second] == v[j->second]) return;
+      }
+    }
+    unique[b] = 1;
   };
+  parallel::For((int64_t)kBucketCount, check_f);
 
-  std::sort(pv.begin(), pv.end(), compare);
+  return std::count(unique.begin(), unique.end(), 0) == 0;
+}
 
-  return std::adjacent_find(pv.begin(), pv.end(), compare) == pv.end();
+namespace details {
+// leaves[i] = KToH256(k[i]), keccak256(x || y) hashed as pairs by the
+// multi-buffer keccak
+inline std::vector<h256_t> KToH256(std::vector<G1> const& k) {
+  std::vector<h256_t> xy(k.size() * 2);
+  auto parallel_f = [&k, &xy](int64_t i) {
+    G1 const& g = k[i];
+    assert(g.isNormalized());
+    if (g.z != 1) return;  // zero, keep x, y empty
+    g.x.serialize(xy[i * 2].data(), kFpBinSize);
+    g.y.serialize(xy[i * 2 + 1].data(), kFpBinSize);
+  };
+  parallel::For((int64_t)k.size(), parallel_f);
+
+  std::vector<h256_t> leaves(k.size());
+  keccak::ParallelHashPairs(xy.data(), leaves.data(), k.size());
+  return leaves;
 }
+}  // namespace details
 
 // since we need to verify the mkl path in contract, we use plain G1
 inline h256_t CalcRootOfK(std::vector<G1> const& k) {
   Tick _tick_(__FUNCTION__);
-  auto get_k = [&k](uint64_t i) -> h256_t {
-    assert(i < k.size());
-    return details::KToH256(k[i]);
+  auto leaves = details::KToH256(k);
+  auto get_k = [&leaves](uint64_t i) -> h256_t {
+    assert(i < leaves.size());
+    return leaves[i];
   };
-  return mkl::CalcRoot(std::move(get_k), k.size());
+  return mkl::ParallelCalcRoot(get_k, k.size());
 }
 
 // since we need to verify the mkl path in contract, we use plain G1
@@ -18,6 +18,7 @@ inline uint64_t GetDataBlockCount(uint64_t size, uint64_t column_num) {
 
 inline bool DataToM(std::string const& pathname, uint64_t size, uint64_t n,
                     uint64_t column_num, std::vector<Fr>& m) {
+  Tick _tick_(__FUNCTION__);
   try {
     io::mapped_file_params params;
     params.path = pathname;
@@ -30,14 +31,157 @@ inline bool DataToM(std::string const& pathname, uint64_t size, uint64_t n,
 
     auto s = column_num + 1;
     m.resize(n * s);
-    for (uint64_t i = 0; i < n; ++i) {
+    // FrRand() draws from tls_rng, so every thread has its own stream
+    auto parallel_f = [start, end, s, column_num, &m](int64_t i) {
       m[i * s] = FrRand();  // pad random fr
       for (uint64_t j = 1; j < s; ++j) {
         LoadMij(start, end, i, j - 1, column_num, m[i * s + j]);
       }
-    }
+    };
+    parallel::For((int64_t)n, parallel_f);
+    return true;
+  } catch (std::exception&) {
+    return false;
+  }
+}
+
+namespace details {
+// rows [first_row, n) of m and sigma, block_rows rows at a time
+inline void FillMatrixAndSigma(uint8_t const* start, uint8_t const* end,
+                               uint64_t n, uint64_t column_num,
+                               uint64_t first_row, uint64_t block_rows,
+                               uint8_t* matrix_start, uint8_t* sigma_start) {
+  auto s = column_num + 1;
+  std::vector<Fr> m;
+  m.reserve(std::min(n - first_row, block_rows) * s);
+  for (uint64_t row = first_row; row < n; row += block_rows) {
+    uint64_t rows = std::min(block_rows, n - row);
+    m.resize(rows * s);
+    auto matrix_block = matrix_start + row * s * kFrBinSize;
+    auto parallel_f = [start, end, s, column_num, row, matrix_block,
+                       &m](int64_t i) {
+      Fr* mi = &m[i * s];
+      uint8_t* p = matrix_block + i * s * kFrBinSize;
+      mi[0] = FrRand();  // pad random fr
+      FrToBin(mi[0], p);
+      for (uint64_t j = 1; j < s; ++j) {
+        LoadMij(start, end, row + i, j - 1, column_num, mi[j]);
+        FrToBin(mi[j], p + j * kFrBinSize);
+      }
+    };
+    parallel::For((int64_t)rows, parallel_f);
+
+    std::vector<G1> sigmas = CalcSigma(m, rows, s);
+    auto sigma_block = sigma_start + row * kG1CompBinSize;
+    auto parallel_g = [&sigmas, sigma_block](int64_t i) {
+      G1ToBin(sigmas[i], sigma_block + i * kG1CompBinSize);
+    };
+    parallel::For((int64_t)rows, parallel_g);
+  }
+}
+}  // namespace details
+
+// Same output as DataToM() + SaveMatrix() + CalcSigma() + SaveSigma(), but
+// only block_rows rows of m and sigma are in memory at a time.
+inline bool DataToMatrixAndSigma(std::string const& pathname, uint64_t size,
+                                 uint64_t n, uint64_t column_num,
+                                 uint64_t block_rows,
+                                 std::string const& matrix_file,
+                                 std::string const& sigma_file) {
+  Tick _tick_(__FUNCTION__);
+  if (!block_rows) return false;
+  try {
+    io::mapped_file_params params;
+    params.path = pathname;
+    params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view(params);
+    if (view.size() != size) return false;
+
+    auto start = (uint8_t*)view.data();
+    auto end = start + view.size();
+    auto s = column_num + 1;
+
+    io::mapped_file_params matrix_params;
+    matrix_params.path = matrix_file;
+    matrix_params.flags = io::mapped_file_base::readwrite;
+    matrix_params.new_file_size = n * s * kFrBinSize;
+    io::mapped_file matrix_view(matrix_params);
+    auto matrix_start = (uint8_t*)matrix_view.data();
+
+    io::mapped_file_params sigma_params;
+    sigma_params.path = sigma_file;
+    sigma_params.flags = io::mapped_file_base::readwrite;
+    sigma_params.new_file_size = n * kG1CompBinSize;
+    io::mapped_file sigma_view(sigma_params);
+    auto sigma_start = (uint8_t*)sigma_view.data();
+
+    details::FillMatrixAndSigma(start, end, n, column_num, 0, block_rows,
+                                matrix_start, sigma_start);
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
+// Same as DataToMatrixAndSigma(), but the first same_rows rows of the matrix
+// and sigma are copied from the old files of an earlier publish, the data of
+// these rows must be unchanged.
+inline bool AppendMatrixAndSigma(std::string const& pathname, uint64_t size,
+                                 uint64_t n, uint64_t column_num,
+                                 uint64_t block_rows,
+                                 std::string const& old_matrix_file,
+                                 std::string const& old_sigma_file,
+                                 uint64_t same_rows,
+                                 std::string const& matrix_file,
+                                 std::string const& sigma_file) {
+  Tick _tick_(__FUNCTION__);
+  if (!block_rows || same_rows > n) return false;
+  try {
+    io::mapped_file_params params;
+    params.path = pathname;
+    params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source view(params);
+    if (view.size() != size) return false;
+
+    auto start = (uint8_t*)view.data();
+    auto end = start + view.size();
+    auto s = column_num + 1;
+
+    io::mapped_file_params old_matrix_params;
+    old_matrix_params.path = old_matrix_file;
+    old_matrix_params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source old_matrix_view(old_matrix_params);
+    if (old_matrix_view.size() < same_rows * s * kFrBinSize) return false;
+
+    io::mapped_file_params old_sigma_params;
+    old_sigma_params.path = old_sigma_file;
+    old_sigma_params.flags = io::mapped_file_base::readonly;
+    io::mapped_file_source old_sigma_view(old_sigma_params);
+    if (old_sigma_view.size() < same_rows * kG1CompBinSize) return false;
+
+    io::mapped_file_params matrix_params;
+    matrix_params.path = matrix_file;
+    matrix_params.flags = io::mapped_file_base::readwrite;
+    matrix_params.new_file_size = n * s * kFrBinSize;
+    io::mapped_file matrix_view(matrix_params);
+    auto matrix_start = (uint8_t*)matrix_view.data();
+
+    io::mapped_file_params sigma_params;
+    sigma_params.path = sigma_file;
+    sigma_params.flags = io::mapped_file_base::readwrite;
+    sigma_params.new_file_size = n * kG1CompBinSize;
+    io::mapped_file sigma_view(sigma_params);
+    auto sigma_start = (uint8_t*)sigma_view.data();
+
+    memcpy(matrix_start, old_matrix_view.data(), same_rows * s * kFrBinSize);
+    memcpy(sigma_start, old_sigma_view.data(), same_rows * kG1CompBinSize);
+
+    details::FillMatrixAndSigma(start, end, n, column_num, same_rows,
+                                block_rows, matrix_start, sigma_start);
     return true;
   } catch (std::exception&) {
+    assert(false);
     return false;
   }
 }
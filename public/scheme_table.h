@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "ecc.h"
@@ -14,8 +17,67 @@ typedef std::vector<std::string> Record;
 
 typedef std::vector<Record> Table;
 
+// Append-only storage of the strings which are not in the mapped file, the
+// returned views are valid as long as the arena (or the one moved from it).
+class Arena {
+ public:
+  std::string_view Copy(std::string_view str) {
+    char* p = Alloc(str.size());
+    memcpy(p, str.data(), str.size());
+    return std::string_view(p, str.size());
+  }
+
+  char* Alloc(size_t len) {
+    if (len > left_) {
+      size_t size = std::max(kBlockSize, len);
+      blocks_.emplace_back(new char[size]);
+      cur_ = blocks_.back().get();
+      left_ = size;
+    }
+    char* p = cur_;
+    cur_ += len;
+    left_ -= len;
+    return p;
+  }
+
+ private:
+  static constexpr size_t kBlockSize = 1024 * 1024;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* cur_ = nullptr;
+  size_t left_ = 0;
+};
+
+struct RecordView {
+  std::string_view const* fields;
+  uint64_t count;
+  uint64_t size() const { return count; }
+  std::string_view const& operator[](uint64_t i) const { return fields[i]; }
+  std::string_view const* begin() const { return fields; }
+  std::string_view const* end() const { return fields + count; }
+};
+
+// Same as Table but the fields are views into the mapped source file or the
+// arenas, the records are stored row by row.
+struct TableView {
+  uint64_t col_num = 0;
+  std::vector<std::string_view> fields;
+  std::shared_ptr<io::mapped_file_source> file;
+  std::vector<Arena> arenas;
+
+  uint64_t size() const { return col_num ? fields.size() / col_num : 0; }
+  bool empty() const { return fields.empty(); }
+  RecordView operator[](uint64_t i) const {
+    return RecordView{&fields[i * col_num], col_num};
+  }
+  bool operator==(TableView const& v) const {
+    return col_num == v.col_num && fields == v.fields;
+  }
+  bool operator!=(TableView const& v) const { return !((*this) == v); }
+};
+
 enum Type {
-  kCsv,  // now only support csv format
+  kCsv,
+  kBin,  // see table_bin.h
 };
 
 inline std::istream& operator>>(std::istream& in, Type& t) {
@@ -23,6 +85,8 @@ inline std::istream& operator>>(std::istream& in, Type& t) {
   in >> token;
   if (token == "csv") {
     t = Type::kCsv;
+  } else if (token == "bin") {
+    t = Type::kBin;
   } else {
     in.setstate(std::ios_base::failbit);
   }
@@ -32,48 +96,109 @@ inline std::istream& operator>>(std::istream& in, Type& t) {
 inline std::ostream& operator<<(std::ostream& os, Type const& t) {
   if (t == Type::kCsv) {
     os << "csv";
+  } else if (t == Type::kBin) {
+    os << "bin";
   } else {
     os.setstate(std::ios_base::failbit);
   }
   return os;
 }
 
-inline void UniqueRecords(Table& table,
+// Append "_n" to the keys, n counts the same key in the record order. The keys
+// are sharded by hash and every shard keeps the record order, so the shards
+// are counted in parallel. The rows are bucketed by shard (a counting sort)
+// first, so every task walks only its own rows.
+inline void UniqueRecords(TableView& table,
                           std::vector<uint64_t> const& vrf_key_colnums) {
   Tick _tick_(__FUNCTION__);
-  auto unique = [&table](uint64_t pos) {
-    std::map<std::string, size_t> count;
-    for (auto& record : table) {
-      auto& key = record[pos];
-      auto& c = count[key];
-      key += "_" + std::to_string(c++);
+  auto n = table.size();
+  uint64_t shard_count = std::max(1U, std::thread::hardware_concurrency());
+  // the rows are split into shard_count blocks to be bucketed in parallel
+  uint64_t block_size = (n + shard_count - 1) / shard_count;
+  std::vector<uint32_t> shard(n);
+  std::vector<uint64_t> rows(n);
+  std::vector<uint64_t> offsets(shard_count * shard_count);
+  std::vector<uint64_t> shard_begin(shard_count + 1);
+  std::vector<Arena> arenas(shard_count);
+
+  for (auto pos : vrf_key_colnums) {
+    // offsets[b * shard_count + s]: the rows of the shard s in the block b
+    std::fill(offsets.begin(), offsets.end(), 0);
+    auto get_shard = [&table, &shard, &offsets, n, pos, shard_count,
+                      block_size](int64_t b) {
+      auto* count = &offsets[b * shard_count];
+      auto end = std::min(n, (b + 1) * block_size);
+      for (uint64_t i = b * block_size; i < end; ++i) {
+        auto const& key = table.fields[i * table.col_num + pos];
+        shard[i] = std::hash<std::string_view>()(key) % shard_count;
+        ++count[shard[i]];
+      }
+    };
+    parallel::For((int64_t)shard_count, get_shard);
+
+    // then where they are put in rows
+    uint64_t offset = 0;
+    for (uint64_t s = 0; s < shard_count; ++s) {
+      shard_begin[s] = offset;
+      for (uint64_t b = 0; b < shard_count; ++b) {
+        auto& i = offsets[b * shard_count + s];
+        auto count = i;
+        i = offset;
+        offset += count;
+      }
     }
-  };
-
-  for (auto i : vrf_key_colnums) {
-    unique(i);
+    shard_begin[shard_count] = offset;
+
+    auto bucket = [&shard, &rows, &offsets, n, shard_count,
+                   block_size](int64_t b) {
+      auto* offset = &offsets[b * shard_count];
+      auto end = std::min(n, (b + 1) * block_size);
+      for (uint64_t i = b * block_size; i < end; ++i) {
+        rows[offset[shard[i]]++] = i;
+      }
+    };
+    parallel::For((int64_t)shard_count, bucket);
+
+    auto unique = [&table, &rows, &shard_begin, &arenas, pos](int64_t t) {
+      std::unordered_map<std::string_view, size_t> count;
+      count.reserve(shard_begin[t + 1] - shard_begin[t]);
+      auto& arena = arenas[t];
+      for (auto j = shard_begin[t]; j < shard_begin[t + 1]; ++j) {
+        auto& key = table.fields[rows[j] * table.col_num + pos];
+        auto suffix = "_" + std::to_string(count[key]++);
+        char* p = arena.Alloc(key.size() + suffix.size());
+        memcpy(p, key.data(), key.size());
+        memcpy(p + key.size(), suffix.data(), suffix.size());
+        key = std::string_view(p, key.size() + suffix.size());
+      }
+    };
+    parallel::For((int64_t)shard_count, unique);
   }
+
+  for (auto& i : arenas) table.arenas.emplace_back(std::move(i));
 }
 
-inline uint64_t GetRecordSize(Record const& record) {
+template <typename R>
+uint64_t GetRecordSize(R const& record) {
   uint64_t len = record.size() * sizeof(uint32_t);
   for (auto const& i : record) len += i.size();
   return len;
 }
 
-inline uint64_t GetMaxRecordSize(Table const& table) {
+template <typename T>
+uint64_t GetMaxRecordSize(T const& table) {
   uint64_t max_record_len = 0;
-  Record const* r = nullptr;
-  for (auto const& i : table) {
-    auto len = GetRecordSize(i);
+  uint64_t max_index = 0;
+  for (uint64_t i = 0; i < table.size(); ++i) {
+    auto len = GetRecordSize(table[i]);
     if (len > max_record_len) {
       max_record_len = len;
-      r = &i;
+      max_index = i;
     }
   }
-  if (r) {
+  if (max_record_len) {
     std::cout << "max long record: " << max_record_len << "\n";
-    for (auto const& i : *r) {
+    for (auto const& i : table[max_index]) {
       std::cout << i << ";";
     }
   }
@@ -111,7 +236,8 @@ inline bool BinToRecord(std::vector<uint8_t> const& bin, Record& record,
   return true;
 }
 
-inline void RecordToBin(Record const& record, std::vector<uint8_t>& bin) {
+template <typename R>
+void RecordToBin(R const& record, std::vector<uint8_t>& bin) {
   assert(bin.size() >= GetRecordSize(record));
 
   uint8_t* p = bin.data();
@@ -136,8 +262,9 @@ inline void RecordToBin(Record const& record, std::vector<uint8_t>& bin) {
   assert((p - bin.data()) == (int64_t)GetRecordSize(record));
 }
 
-inline void DataToM(Table const& table, std::vector<uint64_t> columens_index,
-                    uint64_t s, vrf::Sk<> const& vrf_sk, std::vector<Fr>& m) {
+template <typename T>
+void DataToM(T const& table, std::vector<uint64_t> columens_index, uint64_t s,
+             vrf::Sk<> const& vrf_sk, std::vector<Fr>& m) {
   Tick _tick_(__FUNCTION__);
   auto record_fr_num = s - 1 - columens_index.size();
   auto n = table.size();
@@ -145,7 +272,7 @@ inline void DataToM(Table const& table, std::vector<uint64_t> columens_index,
   auto parallel_f = [record_fr_num, s, &m, &columens_index, &table,
                      &vrf_sk](int64_t i) mutable {
     std::vector<uint8_t> bin(31 * record_fr_num);
-    auto const& record = table[i];
+    auto&& record = table[i];
     auto record_size = GetRecordSize(record);
     auto offset = i * s;
     for (auto j : columens_index) {
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parallel.h"
+#include "public.h"
+#include "scheme_table.h"
+
+// Columnar binary table, all of the integers are big endian:
+//   magic(8) col_num(8) row_num(8)
+//   col_num * (name_len(4) name)
+//   col_num * column_size(8)
+//   col_num * (row_num * len(4), the row_num fields of the column)
+// It is loaded as a TableView into the mapped file, no field is copied.
+
+namespace scheme::table {
+
+namespace details {
+inline static const char kBinTableMagic[8] = {'P', 'O', 'D', 'T',
+                                              'A', 'B', 'L', 'E'};
+
+inline void PutU32(uint8_t*& p, uint32_t v) {
+  v = boost::endian::native_to_big(v);
+  memcpy(p, &v, sizeof(v));
+  p += sizeof(v);
+}
+
+inline void PutU64(uint8_t*& p, uint64_t v) {
+  v = boost::endian::native_to_big(v);
+  memcpy(p, &v, sizeof(v));
+  p += sizeof(v);
+}
+
+inline uint32_t GetU32(uint8_t const* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return boost::endian::big_to_native(v);
+}
+
+inline uint64_t GetU64(uint8_t const* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return boost::endian::big_to_native(v);
+}
+}  // namespace details
+
+inline bool SaveBinTable(std::string const& output,
+                         std::vector<std::string> const& col_names,
+                         TableView const& table) {
+  Tick _tick_(__FUNCTION__);
+  if (col_names.size() != table.col_num) {
+    assert(false);
+    return false;
+  }
+  try {
+    uint64_t col_num = table.col_num;
+    uint64_t row_num = table.size();
+
+    uint64_t header_size = sizeof(details::kBinTableMagic) + 8 + 8;
+    for (auto const& i : col_names) header_size += 4 + i.size();
+    header_size += col_num * 8;
+
+    // the offset of every column section
+    std::vector<uint64_t> col_size(col_num);
+    auto get_size = [&table, &col_size, row_num](int64_t j) {
+      uint64_t size = row_num * 4;
+      for (uint64_t i = 0; i < row_num; ++i) size += table[i][j].size();
+      col_size[j] = size;
+    };
+    parallel::For((int64_t)col_num, get_size);
+    std::vector<uint64_t> col_offset(col_num + 1);
+    col_offset[0] = header_size;
+    for (uint64_t j = 0; j < col_num; ++j) {
+      col_offset[j + 1] = col_offset[j] + col_size[j];
+    }
+
+    io::mapped_file_params params;
+    params.path = output;
+    params.flags = io::mapped_file_base::readwrite;
+    params.new_file_size = col_offset[col_num];
+    io::mapped_file view(params);
+    auto start = (uint8_t*)view.data();
+
+    uint8_t* p = start;
+    memcpy(p, details::kBinTableMagic, sizeof(details::kBinTableMagic));
+    p += sizeof(details::kBinTableMagic);
+    details::PutU64(p, col_num);
+    details::PutU64(p, row_num);
+    for (auto const& i : col_names) {
+      details::PutU32(p, (uint32_t)i.size());
+      memcpy(p, i.data(), i.size());
+      p += i.size();
+    }
+    for (auto i : col_size) details::PutU64(p, i);
+    assert(p == start + header_size);
+
+    auto write_column = [start, &table, &col_offset, row_num](int64_t j) {
+      uint8_t* len_p = start + col_offset[j];
+      uint8_t* data_p = len_p + row_num * 4;
+      for (uint64_t i = 0; i < row_num; ++i) {
+        auto const& field = table[i][j];
+        details::PutU32(len_p, (uint32_t)field.size());
+        memcpy(data_p, field.data(), field.size());
+        data_p += field.size();
+      }
+      assert(data_p == start + col_offset[j + 1]);
+    };
+    parallel::For((int64_t)col_num, write_column);
+    return true;
+  } catch (std::exception&) {
+    assert(false);
+    return false;
+  }
+}
+
+inline bool LoadBinTable(std::string const& input,
+                         std::vector<std::string>& col_names,
+                         TableView& table) {
+  Tick _tick_(__FUNCTION__);
+  try {
+    io::mapped_file_params params;
+    params.path = input;
+    params.flags = io::mapped_file_base::readonly;
+    auto view = std::make_shared<io::mapped_file_source>(params);
+    auto start = (uint8_t const*)view->data();
+    auto end = start + view->size();
+
+    uint64_t fixed_size = sizeof(details::kBinTableMagic) + 8 + 8;
+    if (view->size() < fixed_size ||
+        memcmp(start, details::kBinTableMagic,
+               sizeof(details::kBinTableMagic))) {
+      std::cerr << "invalid bin table: " << input << "\n";
+      return false;
+    }
+    uint8_t const* p = start + sizeof(details::kBinTableMagic);
+    uint64_t col_num = details::GetU64(p);
+    uint64_t row_num = details::GetU64(p + 8);
+    p += 16;
+
+    col_names.resize(col_num);
+    for (auto& i : col_names) {
+      if (end - p < 4) return false;
+      uint32_t len = details::GetU32(p);
+      p += 4;
+      if ((uint64_t)(end - p) < len) return false;
+      i.assign((char const*)p, len);
+      p += len;
+    }
+
+    if ((uint64_t)(end - p) / 8 < col_num) return false;
+    std::vector<uint8_t const*> col_start(col_num);
+    std::vector<uint64_t> col_size(col_num);
+    uint8_t const* col_p = p + col_num * 8;
+    for (uint64_t j = 0; j < col_num; ++j) {
+      col_size[j] = details::GetU64(p + j * 8);
+      col_start[j] = col_p;
+      if (col_size[j] / 4 < row_num || (uint64_t)(end - col_p) < col_size[j])
+        return false;
+      col_p += col_size[j];
+    }
+    if (col_p != end) return false;
+
+    table.col_num = col_num;
+    table.fields.resize(col_num * row_num);
+    std::vector<uint8_t> col_ok(col_num);
+    auto parallel_f = [&table, &col_start, &col_size, &col_ok, col_num,
+                       row_num](int64_t j) {
+      uint8_t const* len_p = col_start[j];
+      auto data_p = (char const*)(len_p + row_num * 4);
+      uint64_t left = col_size[j] - row_num * 4;
+      for (uint64_t i = 0; i < row_num; ++i) {
+        uint32_t len = details::GetU32(len_p + i * 4);
+        if (len > left) return;
+        table.fields[i * col_num + j] = std::string_view(data_p, len);
+        data_p += len;
+        left -= len;
+      }
+      col_ok[j] = left == 0;
+    };
+    parallel::For((int64_t)col_num, parallel_f);
+    if (std::count(col_ok.begin(), col_ok.end(), 0)) {
+      std::cerr << "invalid bin table: " << input << "\n";
+      return false;
+    }
+
+    table.file = std::move(view);
+    table.arenas.clear();
+    return true;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+}
+
+}  // namespace scheme::table
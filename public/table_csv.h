@@ -0,0 +1,286 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parallel.h"
+#include "public.h"
+#include "scheme_table.h"
+
+// Parallel csv loader over the mapped file. The delimiter is ',', a field can
+// be quoted by '"' and "" in a quoted field is a '"'. A quote which is not at
+// the beginning of a field is a normal char, such field must not contain a
+// line break.
+
+namespace scheme::table {
+
+namespace details {
+// parse one record at p, its fields are appended to fields, the quoted fields
+// with "" are unescaped into arena. Return the beginning of the next record.
+inline char const* ParseCsvRecord(char const* p, char const* end,
+                                  std::vector<std::string_view>& fields,
+                                  Arena& arena) {
+  for (;;) {
+    std::string_view field;
+    if (p < end && *p == '"') {
+      char const* begin = ++p;
+      bool escaped = false;
+      while (p < end) {
+        if (*p == '"') {
+          if (p + 1 < end && p[1] == '"') {
+            escaped = true;
+            p += 2;
+            continue;
+          }
+          break;
+        }
+        ++p;
+      }
+      field = std::string_view(begin, p - begin);
+      if (escaped) {
+        char* out = arena.Alloc(field.size());
+        size_t len = 0;
+        for (size_t i = 0; i < field.size(); ++i) {
+          out[len++] = field[i];
+          if (field[i] == '"') ++i;  // skip the second quote
+        }
+        field = std::string_view(out, len);
+      }
+      // drop the chars between the closing quote and the delimiter
+      while (p < end && *p != ',' && *p != '\n') ++p;
+    } else {
+      char const* begin = p;
+      while (p < end && *p != ',' && *p != '\n') ++p;
+      char const* field_end = p;
+      if (field_end > begin && field_end[-1] == '\r' &&
+          (p == end || *p == '\n')) {
+        --field_end;
+      }
+      field = std::string_view(begin, field_end - begin);
+    }
+    fields.push_back(field);
+
+    if (p < end && *p == ',') {
+      ++p;
+      continue;
+    }
+    if (p < end) ++p;  // '\n'
+    return p;
+  }
+}
+
+inline bool IsEmptyLine(char const* p, char const* end) {
+  return *p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n');
+}
+
+// the state of ParseCsvRecord() after a char
+enum CsvState : uint8_t {
+  kCsvRecord,   // a line break out of quotes, a record begins
+  kCsvField,    // a delimiter, a field begins
+  kCsvPlain,    // in a field which is not quoted
+  kCsvQuoted,   // in a quoted field
+  kCsvQuote,    // a quote in a quoted field, closing or escaping
+  kCsvDropped,  // after the closing quote
+  kCsvStateNum
+};
+
+inline uint8_t NextCsvState(uint8_t s, char ch) {
+  switch (s) {
+    case kCsvQuoted:
+      return ch == '"' ? kCsvQuote : kCsvQuoted;
+    case kCsvQuote:
+      if (ch == '"') return kCsvQuoted;  // ""
+      break;
+    case kCsvRecord:
+    case kCsvField:
+      if (ch == '"') return kCsvQuoted;
+      break;
+    default:
+      break;
+  }
+  if (ch == ',') return kCsvField;
+  if (ch == '\n') return kCsvRecord;
+  return s == kCsvQuote || s == kCsvDropped ? kCsvDropped : kCsvPlain;
+}
+
+// the state after [p, e) for each state before it
+inline std::array<uint8_t, kCsvStateNum> RunCsvStates(char const* p,
+                                                      char const* e) {
+  std::array<uint8_t, kCsvStateNum> states;
+  for (uint8_t s = 0; s < kCsvStateNum; ++s) states[s] = s;
+  bool merged = false;
+  for (; p < e && !merged; ++p) {
+    merged = true;
+    for (auto& s : states) {
+      s = NextCsvState(s, *p);
+      merged = merged && s == states[0];
+    }
+  }
+  // all the states are the same, only one is run
+  if (merged) {
+    uint8_t s = states[0];
+    for (; p < e; ++p) s = NextCsvState(s, *p);
+    states.fill(s);
+  }
+  return states;
+}
+}  // namespace details
+
+// The file is split into chunks which are parsed in parallel. The chunk
+// boundaries are moved to the beginning of the next record. The parser state
+// at a boundary is found by running the state machine of the parser over
+// every chunk from every state, then chaining the chunks from the body.
+inline bool LoadCsv(std::string const& file,
+                    std::vector<std::string>& col_names, TableView& table) {
+  Tick _tick_(__FUNCTION__);
+  try {
+    io::mapped_file_params params;
+    params.path = file;
+    params.flags = io::mapped_file_base::readonly;
+    auto view = std::make_shared<io::mapped_file_source>(params);
+    char const* start = view->data();
+    char const* end = start + view->size();
+    if (end - start >= 3 && memcmp(start, "\xEF\xBB\xBF", 3) == 0) {
+      start += 3;  // utf8 bom
+    }
+    if (start == end) return false;
+
+    // the first record is the column names
+    Arena name_arena;
+    std::vector<std::string_view> names;
+    char const* body = details::ParseCsvRecord(start, end, names, name_arena);
+    col_names.assign(names.begin(), names.end());
+    uint64_t col_num = col_names.size();
+
+    if (body == end) {
+      // only the column names, an empty table
+      table.col_num = col_num;
+      table.fields.clear();
+      table.file.reset();
+      table.arenas.clear();
+      return true;
+    }
+
+    uint64_t body_size = end - body;
+    uint64_t chunk_size = std::max<uint64_t>(
+        1024 * 1024,
+        body_size / (std::max(1U, std::thread::hardware_concurrency()) * 4));
+    uint64_t chunk_count = (body_size + chunk_size - 1) / chunk_size;
+
+    std::vector<std::array<uint8_t, details::kCsvStateNum>> chunk_states(
+        chunk_count);
+    auto run_states = [body, end, chunk_size, &chunk_states](int64_t c) {
+      char const* p = body + c * chunk_size;
+      char const* e = std::min(p + chunk_size, end);
+      chunk_states[c] = details::RunCsvStates(p, e);
+    };
+    parallel::For((int64_t)chunk_count, run_states);
+
+    // the state before every chunk, the body begins with a record
+    std::vector<uint8_t> entry(chunk_count);
+    entry[0] = details::kCsvRecord;
+    for (uint64_t c = 1; c < chunk_count; ++c) {
+      entry[c] = chunk_states[c - 1][entry[c - 1]];
+    }
+
+    // record_begin[c] is the first record begins in chunk c, or a later one
+    std::vector<char const*> record_begin(chunk_count + 1);
+    auto find_begin = [body, end, chunk_size, &entry,
+                       &record_begin](int64_t c) {
+      char const* p = body + c * chunk_size;
+      uint8_t s = entry[c];
+      while (s != details::kCsvRecord && p < end) {
+        s = details::NextCsvState(s, *p++);
+      }
+      record_begin[c] = p;
+    };
+    parallel::For((int64_t)chunk_count, find_begin);
+    record_begin[chunk_count] = end;
+
+    std::vector<std::vector<std::string_view>> chunk_fields(chunk_count);
+    std::vector<Arena> arenas(chunk_count);
+    std::vector<uint8_t> chunk_ok(chunk_count);
+    auto parse = [end, col_num, &record_begin, &chunk_fields, &arenas,
+                  &chunk_ok](int64_t c) {
+      auto& fields = chunk_fields[c];
+      char const* p = record_begin[c];
+      char const* e = record_begin[c + 1];
+      while (p < e) {
+        if (details::IsEmptyLine(p, end)) {
+          p += *p == '\n' ? 1 : 2;
+          continue;
+        }
+        auto count = fields.size();
+        p = details::ParseCsvRecord(p, end, fields, arenas[c]);
+        if (fields.size() - count != col_num) return;
+      }
+      chunk_ok[c] = 1;
+    };
+    parallel::For((int64_t)chunk_count, parse);
+
+    std::vector<uint64_t> offsets(chunk_count + 1);
+    for (uint64_t c = 0; c < chunk_count; ++c) {
+      if (!chunk_ok[c]) {
+        std::cerr << "invalid csv record in " << file << "\n";
+        return false;
+      }
+      offsets[c + 1] = offsets[c] + chunk_fields[c].size();
+    }
+
+    table.col_num = col_num;
+    table.fields.resize(offsets[chunk_count]);
+    auto merge = [&table, &offsets, &chunk_fields](int64_t c) {
+      auto& fields = chunk_fields[c];
+      std::copy(fields.begin(), fields.end(),
+                table.fields.begin() + offsets[c]);
+      std::vector<std::string_view>().swap(fields);
+    };
+    parallel::For((int64_t)chunk_count, merge);
+
+    table.file = std::move(view);
+    table.arenas = std::move(arenas);
+    return true;
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return false;
+  }
+}
+
+// a file of only the column names is an empty table, the quoted fields, the
+// "" escapes, the quotes inside a field and CRLF give the fields of the
+// serial parser
+inline bool TestLoadCsv() {
+  auto file = (fs::temp_directory_path() / fs::unique_path()).string();
+  auto load = [&file](std::string const& text,
+                      std::vector<std::string>& col_names, TableView& table) {
+    std::ofstream(file, std::ios::binary) << text;
+    return LoadCsv(file, col_names, table);
+  };
+
+  std::vector<bool> rets;
+  std::vector<std::string> col_names;
+  TableView table;
+  rets.push_back(load("a,b\n", col_names, table) && col_names.size() == 2 &&
+                 table.col_num == 2 && table.empty());
+  rets.push_back(load("a,b", col_names, table) && table.empty());
+
+  rets.push_back(
+      load("a,b\r\n1,\"x,\"\"y\"\"\"\r\nq\"r,\"s\nt\"\n\n", col_names, table));
+  std::vector<std::string_view> fields{"1", "x,\"y\"", "q\"r", "s\nt"};
+  rets.push_back(col_names == std::vector<std::string>{"a", "b"} &&
+                 table.size() == 2 && table.fields == fields);
+
+  boost::system::error_code ec;
+  fs::remove(file, ec);
+  return std::all_of(rets.begin(), rets.end(), [](bool r) { return r; });
+}
+
+}  // namespace scheme::table
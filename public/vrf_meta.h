@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "basic_types.h"
@@ -284,97 +285,141 @@ inline bool LoadBpP1Proof(std::string const& file, h256_t const& digest,
   }
 }
 
-inline void BuildKeyBp(uint64_t n, uint64_t s, std::vector<Fr> const& m,
-                       h256_t const& sigma_mkl_root, uint64_t key_pos,
-                       h256_t keycol_mkl_root, bp::P1Proof& p1_proof) {
+namespace details {
+// v[i] = ChainKeccak256(sigma_mkl_root || keycol_mkl_root, i)
+inline void BuildKeyBpChallenge(uint64_t n, h256_t const& sigma_mkl_root,
+                                h256_t const& keycol_mkl_root,
+                                std::vector<Fr>& v) {
+  uint8_t seed[64];
+  memcpy(seed, sigma_mkl_root.data(), sigma_mkl_root.size());
+  memcpy(seed + 32, keycol_mkl_root.data(), keycol_mkl_root.size());
+  ChainKeccak256(seed, sizeof(seed), n, v);
+}
+
+// the base of the j-th bp item, u1 without the key_pos one
+inline G1 const& GetKeyBpG(uint64_t j, uint64_t key_pos, uint64_t bp_count) {
+  static const G1 g0 = G1Zero();
+  if (j >= bp_count) return g0;
+  auto const& u = GetEccPub().u1();
+  return j < key_pos ? u[j] : u[j + 1];
+}
+}  // namespace details
+
+// Same as calling BuildKeyBp() for every key, key_pos[k] and
+// keycol_mkl_roots[k] are of the k-th key. The rows of m are split into
+// blocks, every block is scanned once for all of the keys and the partial
+// sums are merged at last.
+inline void BuildKeyBps(uint64_t n, uint64_t s, std::vector<Fr> const& m,
+                        h256_t const& sigma_mkl_root,
+                        std::vector<uint64_t> const& key_pos,
+                        std::vector<h256_t> const& keycol_mkl_roots,
+                        std::vector<bp::P1Proof>& p1_proofs) {
+  Tick _tick_(__FUNCTION__);
   assert(m.size() == n * s);
+  assert(key_pos.size() == keycol_mkl_roots.size());
 
-  auto& ecc_pub = GetEccPub();
+  auto key_count = key_pos.size();
   auto bp_count = s - 1;
 
-  uint8_t seed[64];
-  memcpy(seed, sigma_mkl_root.data(), sigma_mkl_root.size());
-  memcpy(seed + 32, keycol_mkl_root.data(), keycol_mkl_root.size());
-  std::vector<Fr> v(n);
-  for (uint64_t i = 0; i < n; ++i) {
-    v[i] = ChainKeccak256(seed, sizeof(seed), i);
+  std::vector<std::vector<Fr>> v(key_count);
+  for (uint64_t k = 0; k < key_count; ++k) {
+    details::BuildKeyBpChallenge(n, sigma_mkl_root, keycol_mkl_roots[k],
+                                 v[k]);
   }
 
-  std::vector<Fr> mv(bp_count);
-  for (uint64_t j = 0; j < s; ++j) {
-    if (j == key_pos) continue;
-    auto jj = j < key_pos ? j : j - 1;
-    mv[jj] = FrZero();
-    for (uint64_t i = 0; i < n; ++i) {
-      mv[jj] += v[i] * m[i * s + j];
+  // mvs[b][k * s + j] = sum(v[k][i] * m[i * s + j]) for the rows of block b
+  static constexpr uint64_t kBlockRows = 1024;
+  uint64_t block_count = (n + kBlockRows - 1) / kBlockRows;
+  uint64_t task_count = std::min<uint64_t>(
+      block_count, std::max(1U, std::thread::hardware_concurrency()) * 4);
+  std::vector<std::vector<Fr>> mvs(task_count);
+  auto parallel_f = [n, s, key_count, block_count, task_count, &m, &v,
+                     &mvs](int64_t t) {
+    auto& mv = mvs[t];
+    mv.resize(key_count * s, FrZero());
+    // task t takes the blocks [begin, end)
+    uint64_t begin = block_count * t / task_count;
+    uint64_t end = block_count * (t + 1) / task_count;
+    for (uint64_t i = begin * kBlockRows; i < std::min(end * kBlockRows, n);
+         ++i) {
+      Fr const* mi = &m[i * s];
+      for (uint64_t k = 0; k < key_count; ++k) {
+        Fr const& vi = v[k][i];
+        Fr* mvk = &mv[k * s];
+        for (uint64_t j = 0; j < s; ++j) mvk[j] += vi * mi[j];
+      }
     }
-  }
-
-  Fr f0 = FrZero();
-  auto get_f = [&mv, &f0, bp_count](uint64_t j) -> Fr const& {
-    if (j < bp_count)
-      return mv[j];
-    else
-      return f0;
   };
+  parallel::For((int64_t)task_count, parallel_f);
 
-  G1 g0 = G1Zero();
-  auto get_g = [&ecc_pub, &g0, key_pos, bp_count](uint64_t j) -> G1 const& {
-    if (j < bp_count) {
-      auto const& u = ecc_pub.u1();
-      if (j < key_pos) {
-        return u[j];
-      } else {
-        return u[j + 1];
-      }
-    } else {
-      return g0;
-    }
+  auto merge = [&mvs, task_count](int64_t j) {
+    for (uint64_t t = 1; t < task_count; ++t) mvs[0][j] += mvs[t][j];
   };
+  if (task_count) parallel::For((int64_t)(key_count * s), merge);
+
+  p1_proofs.resize(key_count);
+  for (uint64_t k = 0; k < key_count; ++k) {
+    // the key column itself is not in the proof
+    std::vector<Fr> mv(bp_count);
+    for (uint64_t j = 0, jj = 0; j < s; ++j) {
+      if (j == key_pos[k]) continue;
+      mv[jj++] = task_count ? mvs[0][k * s + j] : FrZero();
+    }
+
+    Fr f0 = FrZero();
+    auto get_f = [&mv, &f0, bp_count](uint64_t j) -> Fr const& {
+      if (j < bp_count)
+        return mv[j];
+      else
+        return f0;
+    };
+
+    auto pos = key_pos[k];
+    auto get_g = [pos, bp_count](uint64_t j) -> G1 const& {
+      return details::GetKeyBpG(j, pos, bp_count);
+    };
+
+    p1_proofs[k] = bp::P1Prove(get_g, get_f, bp_count);
+  }
+}
 
-  p1_proof = bp::P1Prove(get_g, get_f, bp_count);
+inline void BuildKeyBp(uint64_t n, uint64_t s, std::vector<Fr> const& m,
+                       h256_t const& sigma_mkl_root, uint64_t key_pos,
+                       h256_t keycol_mkl_root, bp::P1Proof& p1_proof) {
+  std::vector<bp::P1Proof> p1_proofs;
+  BuildKeyBps(n, s, m, sigma_mkl_root, {key_pos}, {keycol_mkl_root},
+              p1_proofs);
+  p1_proof = std::move(p1_proofs[0]);
 }
 
 inline bool VerifyKeyBp(uint64_t n, uint64_t s, std::vector<Fr> const& km,
                         std::vector<G1> const& sigmas, uint64_t key_pos,
                         h256_t const& sigma_mkl_root, h256_t keycol_mkl_root,
                         bp::P1Proof const& p1_proof) {
+  Tick _tick_(__FUNCTION__);
   assert(sigmas.size() == n);
   assert(km.size() == n);
 
   auto& ecc_pub = GetEccPub();
   auto bp_count = s - 1;
 
-  uint8_t seed[64];
-  memcpy(seed, sigma_mkl_root.data(), sigma_mkl_root.size());
-  memcpy(seed + 32, keycol_mkl_root.data(), keycol_mkl_root.size());
-  std::vector<Fr> v(n);
-  for (uint64_t i = 0; i < n; ++i) {
-    v[i] = ChainKeccak256(seed, sizeof(seed), i);
-  }
+  std::vector<Fr> v;
+  details::BuildKeyBpChallenge(n, sigma_mkl_root, keycol_mkl_root, v);
 
   std::vector<G1> sigmas2(n);
-  for (uint64_t i = 0; i < n; ++i) {
+  auto parallel_f = [&ecc_pub, &sigmas, &sigmas2, &km, key_pos](int64_t i) {
     G1 u_exp_mi_key = ecc_pub.PowerU1(key_pos, km[i]);
     sigmas2[i] = sigmas[i] - u_exp_mi_key;
-  }
+  };
+  parallel::For((int64_t)n, parallel_f);
+
   if (MultiExpBdlo12(sigmas2, v) != p1_proof.committment.p) {
     assert(false);
     return false;
   }
 
-  G1 g0 = G1Zero();
-  auto get_g = [&ecc_pub, &g0, key_pos, bp_count](uint64_t j) -> G1 const& {
-    if (j < bp_count) {
-      auto const& u = ecc_pub.u1();
-      if (j < key_pos) {
-        return u[j];
-      } else {
-        return u[j + 1];
-      }
-    } else {
-      return g0;
-    }
+  auto get_g = [key_pos, bp_count](uint64_t j) -> G1 const& {
+    return details::GetKeyBpG(j, key_pos, bp_count);
   };
 
   return P1Verify(p1_proof, get_g, bp_count);
@@ -396,7 +441,7 @@ inline bool VerifyKeyBp(std::string const& file, Bulletin const& bulletin,
 }
 
 // hash(fsk(sk, hash(key)))
-inline h256_t HashVrfKey(std::string const& k, vrf::Sk<> const& vrf_sk) {
+inline h256_t HashVrfKey(std::string_view k, vrf::Sk<> const& vrf_sk) {
   CryptoPP::Keccak_256 hash;
   h256_t h_key;
   hash.Update((uint8_t*)k.data(), k.size());
@@ -19,20 +19,4 @@ void serialize(Ar &ar, Proof &t) {
                      ("php", t.proof_hp), ("pip", t.proof_ip));
 }
 
-// save to bin
-template <typename Ar>
-void serialize(Ar &ar, Cache const &t) {
-  ar &YAS_OBJECT_NVP("cache", ("c", t.count), ("s", t.seed), ("k", t.key),
-                     ("kcr", t.key_com_r), ("vc", t.var_coms),
-                     ("vcr", t.var_coms_r));
-}
-
-// load from bin
-template <typename Ar>
-void serialize(Ar &ar, Cache &t) {
-  ar &YAS_OBJECT_NVP("cache", ("c", t.count), ("s", t.seed), ("k", t.key),
-                     ("kcr", t.key_com_r), ("vc", t.var_coms),
-                     ("vcr", t.var_coms_r));
-}
-
 }  // namespace vrs
\ No newline at end of file
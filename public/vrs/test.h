@@ -100,6 +100,148 @@ inline void TestLarge() {
   std::cout << (ret ? "success" : "failed") << "\n";
 }
 
+// a multi-chunk proof passes the batch, one tampered chunk fails the batch
+// and then the verification of every chunk
+inline bool TestLargeBatch() {
+  auto rom_seed = misc::RandH256();
+  int64_t count = kMaxUnitPerZkp * 2 + 7;
+  h256_t vrs_plain_seed = misc::RandH256();
+  auto get_p = [&vrs_plain_seed](int64_t i) {
+    return GeneratePlain(vrs_plain_seed, i);
+  };
+  vrs::PublicInput public_input(count, std::move(get_p));
+
+  vrs::SecretInput secret_input{FrRand(), FrRand(), FrRand()};
+
+  std::vector<vrs::Proof> proofs;
+  vrs::ProveOutput prove_output;
+  vrs::LargeProver prover(public_input, secret_input,
+                          std::vector<std::vector<G1>>(),
+                          std::vector<std::vector<Fr>>());
+  prover.Evaluate();
+
+  std::vector<Fr> w(count);
+  FrRand(w.data(), count);
+  auto get_w = [&w](int64_t i) { return w[i]; };
+  prover.Prove(rom_seed, get_w, proofs, prove_output);
+  assert(proofs.size() == 3);
+
+  std::vector<bool> rets;
+  vrs::VerifyOutput verify_output;
+  vrs::LargeVerifier verifier(public_input);
+  bool ret = verifier.Verify(rom_seed, get_w, proofs, verify_output, true);
+  assert(ret);
+  rets.push_back(ret);
+
+#ifdef NDEBUG
+  // z_delta is only checked by the final equation of the chunk, the chunk
+  // verifier asserts it, so the tampered proof is only run without asserts
+  proofs[1].proof_ip.proof.z_delta += FrOne();
+  vrs::LargeVerifier batch_verifier(public_input);
+  ret = batch_verifier.Verify(rom_seed, get_w, proofs, verify_output, true);
+  assert(!ret);
+  rets.push_back(!ret);
+
+  vrs::LargeVerifier chunk_verifier(public_input);
+  ret = chunk_verifier.Verify(rom_seed, get_w, proofs, verify_output, false);
+  assert(!ret);
+  rets.push_back(!ret);
+#endif
+
+  ret = std::all_of(rets.begin(), rets.end(), [](bool r) { return r; });
+  std::cout << (ret ? "success" : "failed") << "\n";
+  return ret;
+}
+
+// a claim takes the ready file of the lowest upgrade cost, a released file
+// can be claimed again and an exhausted one is removed
+inline bool TestCacheStore() {
+  auto dir = (fs::temp_directory_path() / fs::unique_path()).string();
+  fs::create_directories(dir);
+  std::vector<bool> rets;
+  CacheStore store(dir);
+  std::vector<std::string> files;
+  for (int64_t n : {1, 4, 9}) {
+    auto count = kMaxUnitPerZkp * n;
+    auto seed = misc::RandH256();
+    files.push_back(dir + "/" + GetCacheName(count, seed));
+    std::ofstream(files.back()).put('0');
+    rets.push_back(store.Add(count, seed));
+  }
+
+  // shrinking to 4 * kMaxUnitPerZkp - 1 patches one unit, growing the
+  // smallest one costs 3 * kMaxUnitPerZkp - 1
+  auto count = kMaxUnitPerZkp * 4 - 1;
+  auto file = store.Claim(count);
+  rets.push_back(file == files[1]);
+  rets.push_back(store.Claim(count) == files[2]);
+  rets.push_back(store.Release(file));
+  rets.push_back(store.Claim(count) == files[1]);
+  rets.push_back(store.Exhaust(file));
+  rets.push_back(!fs::exists(file));
+  rets.push_back(store.Claim(count) == files[0]);
+  rets.push_back(store.Claim(count).empty());
+
+  // the claims of a live process are kept
+  rets.push_back(store.Recover() == 0);
+  rets.push_back(store.Rebuild());
+  std::map<int64_t, std::pair<int64_t, int64_t>> stats;
+  rets.push_back(store.GetStats(stats));
+  rets.push_back(stats.size() == 2 && stats[kMaxUnitPerZkp].second == 1 &&
+                 stats[kMaxUnitPerZkp * 9].second == 1);
+
+  boost::system::error_code ec;
+  fs::remove_all(dir, ec);
+  bool ret = std::all_of(rets.begin(), rets.end(), [](bool r) { return r; });
+  std::cout << (ret ? "success" : "failed") << "\n";
+  return ret;
+}
+
+// a saved cache file reads back the same cache, the file is rejected under
+// another mac key or after a byte is changed
+inline bool TestCacheFile() {
+  auto dir = (fs::temp_directory_path() / fs::unique_path()).string();
+  fs::create_directories(dir);
+  std::vector<bool> rets;
+  auto cache = CreateCache(kMaxUnitPerZkp * 2 + 3);
+  h256_t mac_key;
+  rets.push_back(GetCacheMacKey(dir, mac_key));
+  auto file = dir + "/" + GetCacheName(cache.count, cache.seed);
+  rets.push_back(SaveCacheFile(file, cache, mac_key));
+
+  Cache loaded;
+  rets.push_back(LoadCache(file, loaded, true));
+  rets.push_back(loaded.count == cache.count && loaded.seed == cache.seed &&
+                 loaded.key == cache.key &&
+                 loaded.key_com_r == cache.key_com_r &&
+                 loaded.var_coms == cache.var_coms &&
+                 loaded.var_coms_r == cache.var_coms_r);
+
+  {
+    MappedCache mapped;
+    rets.push_back(mapped.Open(file, 1));
+    rets.push_back(mapped.chunk_num() == (int64_t)cache.var_coms.size());
+    CacheFile other_key;
+    rets.push_back(!other_key.Open(file, misc::RandH256()));
+  }
+
+  {
+    std::fstream stream(file, std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekg(-1, std::ios::end);
+    auto c = (char)stream.get();
+    stream.seekp(-1, std::ios::end);
+    stream.put(c ^ 1);
+  }
+  CacheFile damaged;
+  rets.push_back(!damaged.Open(file, mac_key));
+
+  boost::system::error_code ec;
+  fs::remove_all(dir, ec);
+  bool ret = std::all_of(rets.begin(), rets.end(), [](bool r) { return r; });
+  std::cout << (ret ? "success" : "failed") << "\n";
+  return ret;
+}
+
 inline void TestCache() {
   std::vector<bool> rets;
   // std::string output_file;
@@ -1,16 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <numeric>
+#include <random>
+
 #include "parallel.h"
 #include "public.h"
-#include "serialize.h"
+#include "vrs_cache_file.h"
+#include "vrs_cache_store.h"
 #include "vrs_mimc5_gadget.h"
 #include "vrs_misc.h"
 
 namespace vrs {
 
-inline static const std::string kExtensionUsing = ".using";
-inline static const std::string kExtensionUsed = ".used";
-
 inline bool CheckVarComs(h256_t const& seed, Fr const& key, Fr const& key_com_r,
                          int64_t begin, int64_t end,
                          std::vector<G1> const& var_coms,
@@ -18,12 +20,7 @@ inline bool CheckVarComs(h256_t const& seed, Fr const& key, Fr const& key_com_r,
   using groth09::details::ComputeCommitment;
   static constexpr int64_t kPrimaryInputSize = 1;
   auto count = end - begin;
-  std::vector<Fr> v(count);
-  std::vector<std::vector<Fr>> values(count);
-  libsnark::protoboard<Fr> pb;
-  Mimc5Gadget gadget(pb);
-  pb.set_input_sizes(kPrimaryInputSize);
-  auto num_var = (int64_t)pb.num_variables();
+  auto num_var = kMimc5VarNum;
   if ((int64_t)var_coms.size() != num_var) {
     assert(false);
     return false;
@@ -33,22 +30,14 @@ inline bool CheckVarComs(h256_t const& seed, Fr const& key, Fr const& key_com_r,
     return false;
   }
 
-  for (int64_t i = 0; i < count; ++i) {
-    auto plain = GeneratePlain(seed, i + begin);
-    gadget.Assign(plain, key);
-    assert(pb.is_satisfied());
-    v[i] = pb.val(gadget.result());
-    values[i] = pb.full_variable_assignment();
-  }
+  std::vector<Fr> plains(count);
+  GeneratePlain(plains.data(), seed, begin, count);
+  std::vector<Fr> values(num_var * count);
+  Mimc5Witness(plains.data(), key, count, count, values.data());
 
   for (int64_t i = 0; i < num_var; ++i) {
     auto& var_com = var_coms[i];
     auto& var_com_r = var_coms_r[i];
-    std::vector<Fr> data(count);
-    for (int64_t j = 0; j < count; ++j) {
-      auto const& values_j = values[j];
-      data[j] = values_j[i];
-    }
     if (i < kPrimaryInputSize) {
       if (var_com_r != FrZero()) {
         assert(false);
@@ -60,7 +49,8 @@ inline bool CheckVarComs(h256_t const& seed, Fr const& key, Fr const& key_com_r,
         return false;
       }
     }
-    auto check_var_com = ComputeCommitment(data, var_com_r);
+    auto check_var_com =
+        ComputeCommitment(values.data() + i * count, count, var_com_r);
     if (var_com != check_var_com) {
       assert(false);
       return false;
@@ -104,6 +94,47 @@ inline bool CheckCache(Cache const& cache) {
   return true;
 }
 
+// Check the sampled chunks of the file, or all of them if samples <= 0 or
+// >= chunk_num. The mac shows the file is unchanged since it was written,
+// the samples catch a writer which computed wrong commitments. Checking all
+// the chunks also checks the key_com_r of file is the sum of the chunks.
+inline bool CheckCacheFile(CacheFile const& file, int64_t samples) {
+  Tick tick(__FUNCTION__, std::to_string(samples));
+  static constexpr int64_t kPrimaryInputSize = 1;
+  auto items = SplitLargeTask(file.count());
+  std::vector<int64_t> chunks(items.size());
+  std::iota(chunks.begin(), chunks.end(), 0);
+  if (samples > 0 && samples < (int64_t)chunks.size()) {
+    std::shuffle(chunks.begin(), chunks.end(),
+                 std::mt19937_64(std::random_device()()));
+    chunks.resize(samples);
+  }
+
+  std::vector<int64_t> rets(chunks.size());
+  std::vector<Fr> key_coms_r(chunks.size());
+  auto f = [&file, &items, &chunks, &rets, &key_coms_r](int64_t i) {
+    auto const& item = items[chunks[i]];
+    std::vector<G1> var_coms;
+    std::vector<Fr> var_coms_r;
+    file.GetChunk(chunks[i], var_coms, var_coms_r);
+    key_coms_r[i] = var_coms_r[kPrimaryInputSize];
+    rets[i] = CheckVarComs(file.seed(), file.key(), key_coms_r[i],
+                           item.first, item.second, var_coms, var_coms_r);
+  };
+  parallel::For(chunks.size(), f);
+  if (!std::all_of(rets.begin(), rets.end(), [](int64_t r) { return r; })) {
+    return false;
+  }
+
+  // every chunk is checked, the chunk key_com_r must sum to the one of file
+  if (chunks.size() == items.size()) {
+    Fr sum = parallel::Accumulate(key_coms_r.begin(), key_coms_r.end(),
+                                  FrZero());
+    if (sum != file.key_com_r()) return false;
+  }
+  return true;
+}
+
 inline void ComputeVarComs(h256_t const& seed, Fr const& key,
                            Fr const& key_com_r, int64_t begin, int64_t end,
                            std::vector<G1>& var_coms,
@@ -111,31 +142,17 @@ inline void ComputeVarComs(h256_t const& seed, Fr const& key,
   using groth09::details::ComputeCommitment;
   static constexpr int64_t kPrimaryInputSize = 1;
   auto count = end - begin;
-  std::vector<Fr> v(count);
-  std::vector<std::vector<Fr>> values(count);
-  libsnark::protoboard<Fr> pb;
-  Mimc5Gadget gadget(pb);
-  pb.set_input_sizes(kPrimaryInputSize);
-
-  for (int64_t i = 0; i < count; ++i) {
-    auto plain = GeneratePlain(seed, i + begin);
-    gadget.Assign(plain, key);
-    assert(pb.is_satisfied());
-    v[i] = pb.val(gadget.result());
-    values[i] = pb.full_variable_assignment();
-  }
+  std::vector<Fr> plains(count);
+  GeneratePlain(plains.data(), seed, begin, count);
+  auto num_var = kMimc5VarNum;
+  std::vector<Fr> values(num_var * count);
+  Mimc5Witness(plains.data(), key, count, count, values.data());
 
-  auto num_var = (int64_t)pb.num_variables();
   var_coms.resize(num_var);
   var_coms_r.resize(num_var);
   for (int64_t i = 0; i < num_var; ++i) {
     auto& var_com = var_coms[i];
     auto& var_com_r = var_coms_r[i];
-    std::vector<Fr> data(count);
-    for (int64_t j = 0; j < count; ++j) {
-      auto const& values_j = values[j];
-      data[j] = values_j[i];
-    }
     if (i < kPrimaryInputSize) {
       var_com_r = FrZero();
     } else if (i == kPrimaryInputSize) {
@@ -143,7 +160,7 @@ inline void ComputeVarComs(h256_t const& seed, Fr const& key,
     } else {
       var_com_r = FrRand();
     }
-    var_com = ComputeCommitment(data, var_com_r);
+    var_com = ComputeCommitment(values.data() + i * count, count, var_com_r);
   }
 }
 
@@ -153,36 +170,23 @@ inline void UpgradeVarComs(h256_t const& seed, Fr const& key, int64_t begin,
   Tick tick(__FUNCTION__);
   if (old_end == new_end) return;
   using groth09::details::ComputeCommitment;
-  static constexpr int64_t kPrimaryInputSize = 1;
   auto min_end = std::min(old_end, new_end);
   auto max_end = std::max(old_end, new_end);
   bool is_grow = new_end > old_end;
   auto count = max_end - min_end;
-  std::vector<std::vector<Fr>> values(count);
-  libsnark::protoboard<Fr> pb;
-  Mimc5Gadget gadget(pb);
-  pb.set_input_sizes(kPrimaryInputSize);
-
-  for (int64_t i = 0; i < count; ++i) {
-    auto plain = GeneratePlain(seed, i + min_end);
-    gadget.Assign(plain, key);
-    assert(pb.is_satisfied());
-    values[i] = pb.full_variable_assignment();
-  }
+  std::vector<Fr> plains(count);
+  GeneratePlain(plains.data(), seed, min_end, count);
+  auto num_var = kMimc5VarNum;
+  std::vector<Fr> values(num_var * count);
+  Mimc5Witness(plains.data(), key, count, count, values.data());
 
-  auto num_var = (int64_t)pb.num_variables();
   assert(num_var == (int64_t)var_coms.size());
   var_coms.resize(num_var);
   auto const* g = GetPdsPub().g().data() + min_end - begin;
   auto parallel_f = [&var_coms, &values, is_grow, count,
                      g](uint64_t i) mutable {
     auto& var_com = var_coms[i];
-    std::vector<Fr> data(count);
-    for (int64_t j = 0; j < count; ++j) {
-      auto const& values_j = values[j];
-      data[j] = values_j[i];
-    }
-    auto delta = MultiExpBdlo12(g, data.data(), count);
+    auto delta = MultiExpBdlo12(g, values.data() + i * count, count);
     if (is_grow) {
       var_com += delta;
     } else {
@@ -219,30 +223,39 @@ inline Cache CreateCache(int64_t count) {
   };
   parallel::For(items.size(), f);
 
-  assert(CheckCache(cache));
   return cache;
 }
 
 inline bool LoadCache(std::string const& pathname, Cache& cache,
                       bool check_name) {
   Tick tick(__FUNCTION__);
-  try {
-    yas::file_istream is(pathname.c_str());
-    yas::binary_iarchive<yas::file_istream, YasBinF()> ia(is);
-    // yas::json_iarchive<yas::file_istream> ia(is);
-    ia.serialize(cache);
-  } catch (std::exception& e) {
-    std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
+  CacheFile file;
+  h256_t mac_key;
+  auto dir = fs::path(pathname).parent_path().string();
+  if (!GetCacheMacKey(dir, mac_key)) {
+    std::cerr << __FUNCTION__ << ": no mac key in " << dir << "\n";
+    return false;
+  }
+  if (!file.Open(pathname, mac_key)) {
+    std::cerr << __FUNCTION__ << ": invalid cache file " << pathname << "\n";
     boost::system::error_code ec;
     fs::remove(pathname, ec);
     return false;
   }
 
+  cache.count = file.count();
+  cache.seed = file.seed();
+  cache.key = file.key();
+  cache.key_com_r = file.key_com_r();
+  cache.var_coms.resize(file.chunk_num());
+  cache.var_coms_r.resize(file.chunk_num());
+  for (int64_t i = 0; i < file.chunk_num(); ++i) {
+    file.GetChunk(i, cache.var_coms[i], cache.var_coms_r[i]);
+  }
+
   if (check_name) {
     auto base = fs::basename(pathname);
-    auto check_base =
-        std::to_string(cache.count) + "_" + misc::HexToStr(cache.seed);
-    return base == check_base;
+    return base == GetCacheName(cache.count, cache.seed);
   }
 
   return true;
@@ -251,129 +264,41 @@ inline bool LoadCache(std::string const& pathname, Cache& cache,
 inline bool SaveCache(std::string const& dir, Cache const& cache,
                       std::string& output) {
   Tick tick(__FUNCTION__);
-  std::string base_name =
-      std::to_string(cache.count) + "_" + misc::HexToStr(cache.seed);
-  std::string temp_name = base_name + ".tmp";
-  std::string temp_path_name = dir + "/" + temp_name;
+  std::string base_name = GetCacheName(cache.count, cache.seed);
+  std::string temp_path_name = dir + "/" + base_name + ".tmp";
   output = dir + "/" + base_name;
 
-  try {
-    yas::file_ostream os(temp_path_name.c_str());
-    yas::binary_oarchive<yas::file_ostream, YasBinF()> oa(os);
-    // yas::json_oarchive<yas::file_ostream> oa(os);
-    oa.serialize(cache);
-  } catch (std::exception& e) {
-    std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
-    fs::remove(temp_path_name);
+  h256_t mac_key;
+  if (!GetCacheMacKey(dir, mac_key)) return false;
+
+  boost::system::error_code ec;
+  if (!SaveCacheFile(temp_path_name, cache, mac_key)) {
+    fs::remove(temp_path_name, ec);
     return false;
   }
 
-  boost::system::error_code ec;
   fs::rename(temp_path_name, output, ec);
   if (ec) {
-    fs::remove(temp_path_name);
+    fs::remove(temp_path_name, ec);
     return false;
   }
 
-#ifdef _DEBUG
-  Cache check_cache;
-  assert(LoadCache(output, check_cache, true) && check_cache == cache);
-#endif
-  return true;
+  return CacheStore(dir).Add(cache.count, cache.seed);
 }
 
+// claim a cache file of the dir for count units, "" if none is worth it
 inline std::string SelectCacheFile(std::string const& dir, int64_t count) {
-  boost::system::error_code ec;
-  if (!fs::is_directory(dir, ec)) return "";
-
-  auto get_count_from_name = [](std::string const& name) -> int64_t {
-    auto pos = name.find("_");
-    if (pos == std::string::npos) return 0;
-    if (name.size() != pos + 1 + 64) return 0;
-    auto s = name.substr(0, pos);
-    try {
-      return std::stoull(s.c_str());
-    } catch (std::exception&) {
-      return 0;
-    }
-  };
-
-  struct Item {
-    Item(int64_t c, std::string n = "") : count(c), name(std::move(n)) {}
-    int64_t count;
-    std::string name;
-    bool operator<(Item const& a) const { return count < a.count; }
-    bool operator==(Item const& a) const { return count == a.count; }
-  };
-
-  std::vector<Item> files;
-  auto range = boost::make_iterator_range(fs::directory_iterator(dir), {});
-  for (auto& entry : range) {
-    auto basename = fs::basename(entry);
-    auto extension = fs::extension(entry);
-    if (!extension.empty()) continue;
-    auto this_count = get_count_from_name(basename);
-    if (this_count == 0) continue;
-    files.push_back(Item(this_count, std::move(basename)));
-  }
-  if (files.empty()) return "";
-  std::sort(files.begin(), files.end());
-
-  while (!files.empty()) {
-    auto it = std::upper_bound(files.begin(), files.end(), Item(count));
-    if (it == files.begin()) {
-      // all files > count
-      if (count < kMaxUnitPerZkp) {
-        auto count2 = std::min(it->count, kMaxUnitPerZkp);
-        if (count2 >= count * 2) return "";  // no benefit
-      }
-    } else if (it == files.end()) {
-      // all files <= count
-      --it;
-    } else {
-      // find the nearest one
-      auto gap1 = it->count - count;
-      assert(gap1 > 0);
-      auto it2 = it - 1;
-      auto gap2 = count - it2->count;
-      assert(gap2 >= 0);
-      if (gap1 >= gap2) it = it2;
-    }
-
-    // try to change the selected file extension
-    auto ori_name = dir + "/" + it->name;
-    auto using_name = ori_name + kExtensionUsing;
-    // auto using_name = fs::change_extension(ori_name, "use");
-
-    try {
-      fs::rename(ori_name, using_name);
-      return using_name;
-    } catch (std::exception& e) {
-      std::cerr << __FUNCTION__ << ":" << e.what() << "\n";
-      files.erase(it);
-    }
-  }
-  return "";
+  return CacheStore(dir).Claim(count);
 }
 
-inline void ReturnCacheFile(std::string const& using_name) {
-  assert(fs::extension(using_name) == kExtensionUsing);
-  auto ori_name = fs::change_extension(using_name, "");
-  try {
-    fs::rename(using_name, ori_name);
-  } catch (std::exception&) {
-    // ignore the error
-  }
+// the swap failed before the key was opened, the file can be used again
+inline void ReturnCacheFile(std::string const& file) {
+  CacheStore(fs::path(file).parent_path().string()).Release(file);
 }
 
-inline void ExhaustCacheFile(std::string const& using_name) {
-  assert(fs::extension(using_name) == kExtensionUsing);
-  auto used_name = fs::change_extension(using_name, kExtensionUsed);
-  try {
-    fs::rename(using_name, used_name);
-  } catch (std::exception&) {
-    // ignore the error
-  }
+// the key was opened, the file is removed
+inline void ExhaustCacheFile(std::string const& file) {
+  CacheStore(fs::path(file).parent_path().string()).Exhaust(file);
 }
 
 inline void UpgradeCache(Cache& cache, int64_t count) {
@@ -430,8 +355,107 @@ inline void UpgradeCache(Cache& cache, int64_t count) {
   }
 
   cache.count = count;
-
-  assert(CheckCache(cache));
 }
 
+// The cache of a swap. The chunks are read from the mapped cache file when
+// the prover starts them, only the chunks changed by Upgrade() are held in
+// memory.
+class MappedCache {
+ public:
+  // the mac is always verified, spot_check: the number of the chunks to check
+  // by CheckCacheFile(), 0 trusts the mac
+  bool Open(std::string const& file, int64_t spot_check = 0) {
+    h256_t mac_key;
+    auto dir = fs::path(file).parent_path().string();
+    if (!ReadCacheMacKey(dir, mac_key)) return false;
+    if (!file_.Open(file, mac_key)) return false;
+    if (spot_check > 0 && !CheckCacheFile(file_, spot_check)) return false;
+    count_ = file_.count();
+    key_com_r_ = file_.key_com_r();
+    patched_.clear();
+    return true;
+  }
+
+  int64_t count() const { return count_; }
+  h256_t const& seed() const { return file_.seed(); }
+  Fr const& key() const { return file_.key(); }
+  Fr const& key_com_r() const { return key_com_r_; }
+  int64_t chunk_num() const { return (int64_t)SplitLargeTask(count_).size(); }
+
+  // var_coms_r[i][1], the key_com_r of the chunk i
+  Fr const& chunk_key_com_r(int64_t i) const {
+    auto it = patched_.find(i);
+    if (it != patched_.end()) return it->second.second[kPrimaryInputSize];
+    return file_.var_coms_r(i)[kPrimaryInputSize];
+  }
+
+  void GetChunk(int64_t i, std::vector<G1>& var_coms,
+                std::vector<Fr>& var_coms_r) const {
+    auto it = patched_.find(i);
+    if (it != patched_.end()) {
+      var_coms = it->second.first;
+      var_coms_r = it->second.second;
+    } else {
+      file_.GetChunk(i, var_coms, var_coms_r);
+    }
+  }
+
+  // the same as UpgradeCache(), the chunks not changed stay in the file
+  void Upgrade(int64_t count) {
+    Tick tick(__FUNCTION__);
+    if (count_ == count) return;
+    auto old_items = SplitLargeTask(count_);
+    auto new_items = SplitLargeTask(count);
+    auto last = std::min(old_items.size(), new_items.size()) - 1;
+    auto& last_chunk = Patch(last);
+    UpgradeVarComs(seed(), key(), old_items[last].first,
+                   old_items[last].second, new_items[last].second,
+                   last_chunk.first);
+
+    if (new_items.size() < old_items.size()) {
+      for (auto i = new_items.size(); i < old_items.size(); ++i) {
+        key_com_r_ -= chunk_key_com_r(i);
+      }
+      patched_.erase(patched_.lower_bound(new_items.size()), patched_.end());
+    } else {
+      auto add_size = new_items.size() - old_items.size();
+      std::vector<Chunk> add_chunks(add_size);
+      std::vector<Fr> key_com_rs(add_size);
+      auto parallel_f = [this, &add_chunks, &key_com_rs, &new_items,
+                         old_size = old_items.size()](int64_t i) {
+        auto const& item = new_items[old_size + i];
+        key_com_rs[i] = FrRand();
+        ComputeVarComs(seed(), key(), key_com_rs[i], item.first, item.second,
+                       add_chunks[i].first, add_chunks[i].second);
+      };
+      parallel::For((int64_t)add_size, parallel_f);
+      for (size_t i = 0; i < add_size; ++i) {
+        patched_[old_items.size() + i] = std::move(add_chunks[i]);
+      }
+      key_com_r_ = parallel::Accumulate(key_com_rs.begin(), key_com_rs.end(),
+                                        key_com_r_);
+    }
+    count_ = count;
+  }
+
+ private:
+  static constexpr int64_t kPrimaryInputSize = 1;
+  typedef std::pair<std::vector<G1>, std::vector<Fr>> Chunk;
+
+  Chunk& Patch(int64_t i) {
+    auto it = patched_.find(i);
+    if (it != patched_.end()) return it->second;
+    auto& chunk = patched_[i];
+    file_.GetChunk(i, chunk.first, chunk.second);
+    return chunk;
+  }
+
+  CacheFile file_;
+  int64_t count_ = 0;
+  Fr key_com_r_;
+  std::map<int64_t, Chunk> patched_;
+};
+
+typedef std::unique_ptr<MappedCache> MappedCacheUPtr;
+
 }  // namespace vrs
\ No newline at end of file
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cryptopp/hmac.h>
+
+#include "ecc.h"
+#include "public.h"
+#include "vrs_mimc5_gadget.h"
+#include "vrs_misc.h"
+#include "vrs_types.h"
+
+namespace vrs {
+
+// The cache file, chunk addressable so the prover maps it and reads a chunk
+// when it starts the chunk:
+//   CacheFileHeader
+//   int64_t offsets[chunk_num]  // of the chunks in the file
+//   chunk: G1 var_coms[var_num], Fr var_coms_r[var_num]
+// The points are normalized (affine) and stored in the native layout of G1
+// and Fr, so they are copied but never deserialized. A file of another
+// build (sizes or representation differ) is rejected.
+// mac: the HMAC-SHA256 of the file (with the mac zeroed) under the mac key
+// of the cache dir, only the processes sharing the dir can write a valid
+// file, and a damaged file is found by hashing instead of CheckCache().
+struct CacheFileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t var_num;
+  uint32_t g1_size;
+  uint32_t fr_size;
+  int64_t count;
+  int64_t chunk_num;
+  h256_t seed;
+  h256_t mac;
+};
+
+inline static const uint64_t kCacheFileMagic = 0x6568636163737276;  // vrscache
+inline static const uint32_t kCacheFileVersion = 2;
+
+// the mac key of the cache dir, false if it does not exist or can not be read
+inline bool ReadCacheMacKey(std::string const& dir, h256_t& key) {
+  std::ifstream is(dir + "/vrs_cache.key", std::ios::binary);
+  return !!is.read((char*)key.data(), key.size());
+}
+
+// The mac key of the cache dir, created by the first caller. The key file is
+// linked into place, so two creators never see different keys.
+inline bool GetCacheMacKey(std::string const& dir, h256_t& key) {
+  std::string file = dir + "/vrs_cache.key";
+  for (int i = 0; i < 2; ++i) {
+    if (ReadCacheMacKey(dir, key)) return true;
+
+    std::string temp_file = file + "." + misc::HexToStr(misc::RandH256());
+    {
+      auto new_key = misc::RandH256();
+      std::ofstream os(temp_file, std::ios::binary | std::ios::trunc);
+      os.write((char const*)new_key.data(), new_key.size());
+      if (!os) return false;
+    }
+    boost::system::error_code ec;
+    fs::create_hard_link(temp_file, file, ec);  // fails if it exists
+    fs::remove(temp_file, ec);
+  }
+  return false;
+}
+
+namespace details {
+// key, key_com_r and FrOne() to check the representation
+inline int64_t CacheFileFrsOffset() { return sizeof(CacheFileHeader); }
+
+inline int64_t CacheFileOffsetsOffset() {
+  return CacheFileFrsOffset() + 3 * sizeof(Fr);
+}
+
+inline int64_t CacheFileChunkSize(int64_t var_num) {
+  return var_num * (sizeof(G1) + sizeof(Fr));
+}
+
+inline int64_t AlignCacheFileOffset(int64_t offset) {
+  static constexpr int64_t kAlign = 64;
+  return (offset + kAlign - 1) / kAlign * kAlign;
+}
+
+inline h256_t ComputeCacheFileMac(h256_t const& mac_key, char const* data,
+                                  size_t size) {
+  static constexpr size_t kMacOffset = offsetof(CacheFileHeader, mac);
+  static const h256_t kZero{};
+  CryptoPP::HMAC<CryptoPP::SHA256> hmac(mac_key.data(), mac_key.size());
+  hmac.Update((uint8_t const*)data, kMacOffset);
+  hmac.Update(kZero.data(), kZero.size());
+  auto rest = kMacOffset + kZero.size();
+  hmac.Update((uint8_t const*)data + rest, size - rest);
+  h256_t mac;
+  hmac.Final(mac.data());
+  return mac;
+}
+}  // namespace details
+
+inline bool SaveCacheFile(std::string const& file, Cache const& cache,
+                          h256_t const& mac_key) {
+  using namespace details;
+  Tick tick(__FUNCTION__);
+  auto chunk_num = (int64_t)cache.var_coms.size();
+  int64_t var_num = kMimc5VarNum;
+  if (cache.var_coms_r.size() != cache.var_coms.size()) return false;
+  for (int64_t i = 0; i < chunk_num; ++i) {
+    if ((int64_t)cache.var_coms[i].size() != var_num) return false;
+    if ((int64_t)cache.var_coms_r[i].size() != var_num) return false;
+  }
+
+  CacheFileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kCacheFileMagic;
+  header.version = kCacheFileVersion;
+  header.var_num = (uint32_t)var_num;
+  header.g1_size = sizeof(G1);
+  header.fr_size = sizeof(Fr);
+  header.count = cache.count;
+  header.chunk_num = chunk_num;
+  header.seed = cache.seed;
+
+  std::vector<int64_t> offsets(chunk_num);
+  int64_t offset =
+      CacheFileOffsetsOffset() + chunk_num * (int64_t)sizeof(int64_t);
+  for (auto& i : offsets) {
+    offset = AlignCacheFileOffset(offset);
+    i = offset;
+    offset += CacheFileChunkSize(var_num);
+  }
+
+  std::vector<char> buf(offset, 0);
+  memcpy(buf.data(), &header, sizeof(header));
+  Fr frs[3] = {cache.key, cache.key_com_r, FrOne()};
+  memcpy(buf.data() + CacheFileFrsOffset(), frs, sizeof(frs));
+  memcpy(buf.data() + CacheFileOffsetsOffset(), offsets.data(),
+         chunk_num * sizeof(int64_t));
+
+  auto parallel_f = [&cache, &offsets, &buf, var_num](int64_t i) {
+    auto const& var_coms = cache.var_coms[i];
+    auto const& var_coms_r = cache.var_coms_r[i];
+    auto* p = buf.data() + offsets[i];
+    for (auto const& var_com : var_coms) {
+      G1 g = var_com;
+      g.normalize();
+      memcpy(p, &g, sizeof(G1));
+      p += sizeof(G1);
+    }
+    memcpy(p, var_coms_r.data(), var_num * sizeof(Fr));
+  };
+  parallel::For(chunk_num, parallel_f);
+
+  header.mac = ComputeCacheFileMac(mac_key, buf.data(), buf.size());
+  memcpy(buf.data() + offsetof(CacheFileHeader, mac), &header.mac,
+         sizeof(header.mac));
+
+  std::ofstream os(file, std::ios::binary | std::ios::trunc);
+  os.write(buf.data(), buf.size());
+  return !!os;
+}
+
+// The mmapped cache file.
+class CacheFile {
+ public:
+  bool Open(std::string const& file, h256_t const& mac_key) {
+    using namespace details;
+    try {
+      boost::system::error_code ec;
+      auto size = (int64_t)fs::file_size(file, ec);
+      if (ec || size < CacheFileOffsetsOffset()) return false;
+      io::mapped_file_params params;
+      params.path = file;
+      params.flags = io::mapped_file_base::readonly;
+      view_.open(params);
+      data_ = view_.data();
+
+      memcpy(&header_, data_, sizeof(header_));
+      if (header_.magic != kCacheFileMagic) return false;
+      if (header_.version != kCacheFileVersion) return false;
+      if (header_.var_num != kMimc5VarNum) return false;
+      if (header_.g1_size != sizeof(G1) || header_.fr_size != sizeof(Fr)) {
+        return false;
+      }
+      if (header_.count <= 0) return false;
+      if (header_.chunk_num != (int64_t)SplitLargeTask(header_.count).size()) {
+        return false;
+      }
+
+      Fr frs[3];
+      memcpy(frs, data_ + CacheFileFrsOffset(), sizeof(frs));
+      if (frs[2] != FrOne()) return false;
+      key_ = frs[0];
+      key_com_r_ = frs[1];
+
+      int64_t offsets_end = CacheFileOffsetsOffset() +
+                            header_.chunk_num * (int64_t)sizeof(int64_t);
+      if (size < offsets_end) return false;
+      offsets_.resize(header_.chunk_num);
+      memcpy(offsets_.data(), data_ + CacheFileOffsetsOffset(),
+             offsets_.size() * sizeof(int64_t));
+      auto chunk_size = CacheFileChunkSize(header_.var_num);
+      for (auto offset : offsets_) {
+        if (offset < offsets_end || offset % alignof(G1)) return false;
+        if (offset + chunk_size > size) return false;
+      }
+      return header_.mac == ComputeCacheFileMac(mac_key, data_, size);
+    } catch (std::exception& e) {
+      std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
+      return false;
+    }
+  }
+
+  int64_t count() const { return header_.count; }
+  h256_t const& seed() const { return header_.seed; }
+  Fr const& key() const { return key_; }
+  Fr const& key_com_r() const { return key_com_r_; }
+  int64_t chunk_num() const { return header_.chunk_num; }
+
+  G1 const* var_coms(int64_t i) const {
+    return (G1 const*)(data_ + offsets_[i]);
+  }
+
+  Fr const* var_coms_r(int64_t i) const {
+    return (Fr const*)(var_coms(i) + header_.var_num);
+  }
+
+  void GetChunk(int64_t i, std::vector<G1>& var_coms,
+                std::vector<Fr>& var_coms_r) const {
+    auto p = this->var_coms(i);
+    var_coms.assign(p, p + header_.var_num);
+    auto q = this->var_coms_r(i);
+    var_coms_r.assign(q, q + header_.var_num);
+  }
+
+ private:
+  io::mapped_file_source view_;
+  char const* data_ = nullptr;
+  CacheFileHeader header_;
+  Fr key_;
+  Fr key_com_r_;
+  std::vector<int64_t> offsets_;
+};
+
+}  // namespace vrs
@@ -0,0 +1,439 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "misc.h"
+#include "public.h"
+#include "vrs_misc.h"
+
+namespace vrs {
+
+// the extensions of the old renaming scheme, Rebuild() converts them
+inline static const std::string kExtensionUsing = ".using";
+inline static const std::string kExtensionUsed = ".used";
+
+// the count of a cache file from its base name "count_seed", 0 if invalid
+inline int64_t GetCacheCount(std::string const& name) {
+  auto pos = name.find("_");
+  if (pos == std::string::npos) return 0;
+  if (name.size() != pos + 1 + 64) return 0;
+  auto s = name.substr(0, pos);
+  try {
+    return std::stoull(s.c_str());
+  } catch (std::exception&) {
+    return 0;
+  }
+}
+
+inline std::string GetCacheName(int64_t count, h256_t const& seed) {
+  return std::to_string(count) + "_" + misc::HexToStr(seed);
+}
+
+// The units of witness UpgradeCache recomputes to change a cache of
+// old_count into new_count. The chunks are aligned, so shrinking only patches
+// the new last chunk while growing computes all of the added units.
+inline int64_t UpgradeCost(int64_t old_count, int64_t new_count) {
+  if (old_count <= new_count) return new_count - old_count;
+  auto old_items = SplitLargeTask(old_count);
+  auto new_items = SplitLargeTask(new_count);
+  return old_items[new_items.size() - 1].second - new_items.back().second;
+}
+
+// The index of the cache files in a cache dir, the pod_core processes claim
+// a file without listing the dir. It is a mmapped slot table: the ready
+// slots are sorted by count from the head, the claimed slots grow from the
+// tail. Every access holds the lock file (and a mutex for the threads of one
+// process). The files keep their names, only the index changes.
+// A claim of a dead process is exhausted, never returned: the key of the
+// cache may have been opened before the crash.
+class CacheStore {
+ public:
+  explicit CacheStore(std::string dir)
+      : dir_(std::move(dir)),
+        index_file_(dir_ + "/vrs_cache.index"),
+        lock_file_(dir_ + "/vrs_cache.lock") {}
+
+  // register a saved cache file as ready, a file added by Rebuild() already
+  // is not added twice
+  bool Add(int64_t count, h256_t const& seed) {
+    return Update([count, &seed](Table& table) {
+      auto name = GetCacheName(count, seed);
+      auto range = std::equal_range(table.ready_begin(), table.ready_end(),
+                                    Slot{count});
+      for (auto i = range.first; i != range.second; ++i) {
+        if (i->seed == seed) return true;
+      }
+      if (table.FindClaim(name)) return true;
+      if (!table.Reserve()) return false;
+      table.InsertReady(Slot{count, seed, 0, 0});
+      return true;
+    });
+  }
+
+  // claim the ready file with the lowest UpgradeCost (the smaller one if
+  // tie), "" if no file costs less than a new cache. NOTE: the files can not
+  // be composed, the key of a cache is opened in the secret of the swap.
+  std::string Claim(int64_t count) {
+    std::string ret;
+    Update([this, count, &ret](Table& table) {
+      // the claim needs a free slot, Reserve() remaps the table
+      if (!table.Reserve()) return false;
+      auto begin = table.ready_begin();
+      auto end = table.ready_end();
+      // the cost grows with the count above count, and falls below it
+      auto it = std::lower_bound(begin, end, Slot{count});
+      Slot* best = nullptr;
+      auto min_cost = count;  // the cost of a new cache
+      if (it != begin) {
+        auto cost = UpgradeCost((it - 1)->count, count);
+        if (cost < min_cost) {
+          min_cost = cost;
+          best = it - 1;
+        }
+      }
+      if (it != end && UpgradeCost(it->count, count) < min_cost) best = it;
+      if (!best) return false;
+
+      Slot slot = *best;
+      slot.pid = GetPid();
+      slot.time = (int64_t)std::time(nullptr);
+      table.PushClaim(slot);  // claim first, a crash never loses it
+      table.EraseReady(best);
+      ret = dir_ + "/" + GetCacheName(slot.count, slot.seed);
+      return true;
+    });
+    return ret;
+  }
+
+  // the claimed file goes back to ready, its key was not opened
+  bool Release(std::string const& file) {
+    return Update([&file](Table& table) {
+      if (!table.Reserve()) return false;
+      auto claim = table.FindClaim(file);
+      if (!claim) return false;
+      table.InsertReady(*claim);  // ready before the claim is dropped
+      table.EraseClaim(claim);
+      return true;
+    });
+  }
+
+  // remove the claimed file, its key was opened
+  bool Exhaust(std::string const& file) {
+    return Update([&file](Table& table) {
+      auto claim = table.FindClaim(file);
+      if (!claim) return false;
+      boost::system::error_code ec;
+      fs::remove(file, ec);
+      table.EraseClaim(claim);
+      return true;
+    });
+  }
+
+  // exhaust the claims of the dead processes, return the number
+  int64_t Recover() {
+    int64_t ret = 0;
+    Update([this, &ret](Table& table) {
+      std::vector<std::string> dead_files;
+      for (auto i = table.claim_begin(); i != table.claim_end(); ++i) {
+        if (IsAlive(i->pid)) continue;
+        dead_files.push_back(dir_ + "/" + GetCacheName(i->count, i->seed));
+      }
+      for (auto const& file : dead_files) {
+        boost::system::error_code ec;
+        fs::remove(file, ec);
+        table.EraseClaim(table.FindClaim(file));
+        ++ret;
+      }
+      return true;
+    });
+    return ret;
+  }
+
+  // count: {ready, claimed}
+  bool GetStats(std::map<int64_t, std::pair<int64_t, int64_t>>& stats) {
+    return Update([&stats](Table& table) {
+      for (auto i = table.ready_begin(); i != table.ready_end(); ++i) {
+        ++stats[i->count].first;
+      }
+      for (auto i = table.claim_begin(); i != table.claim_end(); ++i) {
+        ++stats[i->count].second;
+      }
+      return true;
+    });
+  }
+
+  // Rebuild the ready slots from the files of the dir, the claims are kept.
+  // The files saved but not added (a crash between them) are picked up.
+  bool Rebuild() {
+    try {
+      std::lock_guard<std::mutex> lock(Mutex());
+      FileLock file_lock(GetLockFile());
+      boost::interprocess::scoped_lock<FileLock> scoped_lock(file_lock);
+      return RebuildLocked();
+    } catch (std::exception& e) {
+      std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
+      return false;
+    }
+  }
+
+ private:
+  typedef boost::interprocess::file_lock FileLock;
+  static constexpr uint64_t kMagic = 0x3130786469737276;  // "vrsidx01"
+  static constexpr int64_t kMinCapacity = 256;
+
+  struct Header {
+    uint64_t magic;
+    int64_t capacity;
+    int64_t ready_size;
+    int64_t claim_size;
+    int64_t dirty;  // set while a slot is moving
+  };
+
+  struct Slot {
+    int64_t count = 0;
+    h256_t seed{};
+    int64_t pid = 0;   // the claimer
+    int64_t time = 0;  // the claim time
+    bool operator<(Slot const& a) const { return count < a.count; }
+  };
+
+  static size_t FileSize(int64_t capacity) {
+    return sizeof(Header) + capacity * sizeof(Slot);
+  }
+
+  class Table {
+   public:
+    explicit Table(std::string const& file) : file_(file) {}
+
+    bool Open() {
+      boost::system::error_code ec;
+      auto size = fs::file_size(file_, ec);
+      if (ec || size < sizeof(Header)) return false;
+      Map();
+      auto const& h = header();
+      return h.magic == kMagic && h.capacity >= kMinCapacity &&
+             size >= FileSize(h.capacity) && h.ready_size >= 0 &&
+             h.claim_size >= 0 && h.ready_size + h.claim_size <= h.capacity;
+    }
+
+    Header& header() { return *(Header*)view_.data(); }
+    Slot* slots() { return (Slot*)(view_.data() + sizeof(Header)); }
+    Slot* ready_begin() { return slots(); }
+    Slot* ready_end() { return slots() + header().ready_size; }
+    Slot* claim_begin() { return claim_end() - header().claim_size; }
+    Slot* claim_end() { return slots() + header().capacity; }
+
+    // make room for one more slot, double the table if full
+    bool Reserve() {
+      auto h = header();
+      if (h.ready_size + h.claim_size < h.capacity) return true;
+      std::vector<Slot> claims(claim_begin(), claim_end());
+      view_.close();
+      auto capacity = h.capacity * 2;
+      boost::system::error_code ec;
+      fs::resize_file(file_, FileSize(capacity), ec);
+      Map();
+      if (ec) return false;  // the table is not changed
+      // the claims are copied before the capacity moves to them
+      std::copy(claims.begin(), claims.end(),
+                slots() + capacity - claims.size());
+      header().capacity = capacity;
+      return true;
+    }
+
+    void InsertReady(Slot const& slot) {
+      auto it = std::upper_bound(ready_begin(), ready_end(), slot);
+      std::copy_backward(it, ready_end(), ready_end() + 1);
+      *it = slot;
+      ++header().ready_size;
+    }
+
+    void EraseReady(Slot* it) {
+      std::copy(it + 1, ready_end(), it);
+      --header().ready_size;
+    }
+
+    void PushClaim(Slot const& slot) {
+      *(claim_begin() - 1) = slot;
+      ++header().claim_size;
+    }
+
+    void EraseClaim(Slot* it) {
+      *it = *claim_begin();
+      --header().claim_size;
+    }
+
+    Slot* FindClaim(std::string const& file) {
+      auto name = fs::basename(file);
+      for (auto i = claim_begin(); i != claim_end(); ++i) {
+        if (GetCacheName(i->count, i->seed) == name) return i;
+      }
+      return nullptr;
+    }
+
+   private:
+    void Map() {
+      io::mapped_file_params params;
+      params.path = file_;
+      params.flags = io::mapped_file_base::readwrite;
+      view_.open(params);
+    }
+
+    std::string const file_;
+    io::mapped_file view_;
+  };
+
+  // one mutex for all of the stores, the file lock does not work between
+  // the threads of one process
+  static std::mutex& Mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static int64_t GetPid() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return getpid();
+#endif
+  }
+
+  // on windows the claims are never treated as dead, only Rebuild() by hand
+  static bool IsAlive(int64_t pid) {
+#ifdef _WIN32
+    (void)pid;
+    return true;
+#else
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+  }
+
+  // the file_lock needs an existing file
+  char const* GetLockFile() const {
+    std::ofstream(lock_file_, std::ios::app);
+    return lock_file_.c_str();
+  }
+
+  template <typename F>
+  bool Update(F f) {
+    try {
+      boost::system::error_code ec;
+      if (!fs::is_directory(dir_, ec)) return false;
+      std::lock_guard<std::mutex> lock(Mutex());
+      FileLock file_lock(GetLockFile());
+      boost::interprocess::scoped_lock<FileLock> scoped_lock(file_lock);
+
+      // a new dir, a broken index, or a crash while moving the slots
+      {
+        Table table(index_file_);
+        if (!table.Open() || table.header().dirty) {
+          std::cerr << "rebuild the cache index: " << index_file_ << "\n";
+          if (!RebuildLocked()) return false;
+        }
+      }
+
+      Table table(index_file_);
+      if (!table.Open()) return false;
+      table.header().dirty = 1;
+      auto ret = f(table);
+      table.header().dirty = 0;
+      return ret;
+    } catch (std::exception& e) {
+      std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
+      return false;
+    }
+  }
+
+  // the claims of the old index whose files exist are kept, all of the other
+  // files are ready
+  bool RebuildLocked() {
+    std::vector<Slot> claims;
+    {
+      Table table(index_file_);
+      if (table.Open()) claims.assign(table.claim_begin(), table.claim_end());
+    }
+
+    std::vector<Slot> ready;
+    boost::system::error_code ec;
+    for (auto& entry : fs::directory_iterator(dir_)) {
+      auto basename = fs::basename(entry);
+      auto extension = fs::extension(entry);
+      Slot slot{GetCacheCount(basename)};
+      if (!slot.count) continue;
+      misc::HexStrToH256(basename.substr(basename.find('_') + 1), slot.seed);
+      if (extension == kExtensionUsed) {
+        fs::remove(entry.path(), ec);
+        continue;
+      }
+      if (extension == kExtensionUsing) {
+        // claimed by the old scheme, maybe opened
+        fs::remove(entry.path(), ec);
+        continue;
+      }
+      if (!extension.empty()) continue;
+      auto it = std::find_if(claims.begin(), claims.end(),
+                             [&slot](Slot const& claim) {
+                               return claim.count == slot.count &&
+                                      claim.seed == slot.seed;
+                             });
+      if (it == claims.end()) ready.push_back(slot);
+    }
+    std::sort(ready.begin(), ready.end());
+
+    // the claims of the missing files are dropped
+    claims.erase(
+        std::remove_if(claims.begin(), claims.end(),
+                       [this](Slot const& claim) {
+                         boost::system::error_code ec;
+                         return !fs::is_regular_file(
+                             dir_ + "/" + GetCacheName(claim.count, claim.seed),
+                             ec);
+                       }),
+        claims.end());
+
+    auto capacity = std::max<int64_t>(
+        kMinCapacity, 2 * (int64_t)(ready.size() + claims.size()));
+    Header header{kMagic, capacity, (int64_t)ready.size(),
+                  (int64_t)claims.size(), 0};
+    std::vector<Slot> slots(capacity);
+    std::copy(ready.begin(), ready.end(), slots.begin());
+    std::copy(claims.begin(), claims.end(), slots.end() - claims.size());
+
+    // write a temp file and rename it, the index is never half written
+    std::string temp_file = index_file_ + ".tmp";
+    {
+      std::ofstream os(temp_file, std::ios::binary | std::ios::trunc);
+      os.write((char const*)&header, sizeof(header));
+      os.write((char const*)slots.data(), slots.size() * sizeof(Slot));
+      if (!os) return false;
+    }
+    fs::rename(temp_file, index_file_);
+    return true;
+  }
+
+  std::string const dir_;
+  std::string const index_file_;
+  std::string const lock_file_;
+};
+
+}  // namespace vrs
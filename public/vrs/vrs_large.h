@@ -1,5 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
+#ifdef USE_TBB
+#include <tbb/task_arena.h>
+#endif
+
 #include "./vrs_cache.h"
 #include "./vrs_misc.h"
 #include "./vrs_prover.h"
@@ -7,6 +14,38 @@
 
 namespace vrs {
 
+namespace details {
+// f(i) for i in [0, count) on at most width threads. The threads are not in
+// the task pool, so the inner parallel loops of f get the idle cores, and
+// while one thread runs the tail of f(i) the next one starts f(i + 1).
+template <typename F>
+void ForPipelined(int64_t count, int64_t width, F& f) {
+  width = std::max<int64_t>(1, std::min(width, count));
+  if (width == 1) {
+    for (int64_t i = 0; i < count; ++i) f(i);
+    return;
+  }
+  std::atomic<int64_t> next{0};
+  auto thread_f = [&next, &f, count]() {
+    for (int64_t i = next++; i < count; i = next++) f(i);
+  };
+  std::vector<std::thread> threads(width);
+  for (auto& t : threads) t = std::thread(thread_f);
+  for (auto& t : threads) t.join();
+}
+
+// the threads of the task pool, so a pipeline is never wider than
+// options:thread_num, 1 if the pool is disabled
+inline int64_t GetPipelineMaxWidth() {
+#ifdef USE_TBB
+  return std::max(1, tbb::this_task_arena::max_concurrency());
+#else
+  auto thread_sum = parallel::details::GetTaskPool().thread_sum();
+  return std::max<int64_t>(1, (int64_t)thread_sum);
+#endif
+}
+}  // namespace details
+
 class LargeProver {
  public:
   LargeProver(PublicInput const& public_input, SecretInput const& secret_input,
@@ -135,16 +174,25 @@ class LargeProver {
   std::vector<Fr> v_;
 };
 
+// Proves the chunks in a pipeline, only a few chunks are in flight.
+// memory_budget: bytes of the chunks in flight, 0 means the default, two
+// chunks.
+// cache: if not null, the cached_var_coms are empty and the var_coms of a
+// chunk are read from the cache as the chunk starts.
 class LargeProverLowRam {
  public:
   LargeProverLowRam(PublicInput const& public_input,
                     SecretInput const& secret_input,
                     std::vector<std::vector<G1>> cached_var_coms,
-                    std::vector<std::vector<Fr>> cached_var_coms_r)
+                    std::vector<std::vector<Fr>> cached_var_coms_r,
+                    int64_t memory_budget = 0,
+                    MappedCache const* cache = nullptr)
       : public_input_(public_input),
         secret_input_(secret_input),
         cached_var_coms_(std::move(cached_var_coms)),
-        cached_var_coms_r_(std::move(cached_var_coms_r)) {
+        cached_var_coms_r_(std::move(cached_var_coms_r)),
+        memory_budget_(memory_budget),
+        cache_(cache) {
     Tick tick(__FUNCTION__);
     items_ = SplitLargeTask(public_input_.count);
     std::cout << "items: " << items_.size() - 1 << "*" << kMaxUnitPerZkp << "+"
@@ -180,8 +228,14 @@ class LargeProverLowRam {
                                return public_input_.get_p(item.first + j);
                              });
 
-      auto& cached_var_com = cached_var_coms_[i];
-      auto& cached_var_com_r = cached_var_coms_r_[i];
+      std::vector<G1> cached_var_com;
+      std::vector<Fr> cached_var_com_r;
+      if (cache_) {
+        cache_->GetChunk(i, cached_var_com, cached_var_com_r);
+      } else {
+        cached_var_com = std::move(cached_var_coms_[i]);
+        cached_var_com_r = std::move(cached_var_coms_r_[i]);
+      }
       Prover prover(this_input, secret_inputs_[i], std::move(cached_var_com),
                     std::move(cached_var_com_r));
 
@@ -195,7 +249,7 @@ class LargeProverLowRam {
       prover.Prove(rom_seed, std::move(this_get_w), proofs[i], outputs[i]);
       vws[i] = prover.vw();
     };
-    parallel::For(size, parallel_f);
+    details::ForPipelined(size, GetPipelineWidth(), parallel_f);
 
     MergeOutputs(output, outputs);
 
@@ -222,6 +276,16 @@ class LargeProverLowRam {
   std::vector<Fr>&& TakeV() { return std::move(v_); }
 
  private:
+  int64_t GetPipelineWidth() const {
+    static constexpr int64_t kDefaultWidth = 2;
+    auto max_width = details::GetPipelineMaxWidth();
+    if (!memory_budget_) return std::min(kDefaultWidth, max_width);
+    auto chunk_memory = Prover::EstimateMemory(
+        std::min<int64_t>(kMaxUnitPerZkp, public_input_.count));
+    auto width = std::max<int64_t>(1, memory_budget_ / chunk_memory);
+    return std::min(width, max_width);
+  }
+
   void BuildSecretInputs() {
     auto size = (int64_t)items_.size();
     secret_inputs_.resize(size);
@@ -231,7 +295,12 @@ class LargeProverLowRam {
       secret_inputs_[i].vw_com_r = vw_com_rs[i];
     }
 
-    if (cached_var_coms_r_.empty()) {
+    if (cache_) {
+      assert(cache_->chunk_num() == size);
+      for (int64_t i = 0; i < size; ++i) {
+        secret_inputs_[i].key_com_r = cache_->chunk_key_com_r(i);
+      }
+    } else if (cached_var_coms_r_.empty()) {
       auto key_com_rs = SplitFr(secret_input_.key_com_r, size);
       for (int64_t i = 0; i < size; ++i) {
         secret_inputs_[i].key_com_r = key_com_rs[i];
@@ -251,6 +320,8 @@ class LargeProverLowRam {
   SecretInput secret_input_;
   std::vector<std::vector<G1>> cached_var_coms_;
   std::vector<std::vector<Fr>> cached_var_coms_r_;
+  int64_t const memory_budget_;
+  MappedCache const* cache_;
   std::vector<SecretInput> secret_inputs_;
   std::vector<std::pair<int64_t, int64_t>> items_;
   Fr vw_;
@@ -270,37 +341,30 @@ class LargeVerifier {
         item.second = public_input.count;
       }
     }
-    auto pair_size = [](std::pair<int64_t, int64_t> const& p) {
-      return p.second - p.first;
-    };
-
-    verifiers_.resize(items_.size());
-    auto parallel_f = [this, &pair_size](int64_t i) mutable {
-      auto const& item = items_[i];
-      PublicInput this_input(pair_size(item), [&item, this](int64_t j) {
-        return public_input_.get_p(item.first + j);
-      });
-      verifiers_[i].reset(new Verifier(this_input));
-    };
-    parallel::For((int64_t)verifiers_.size(), parallel_f);
+    BuildVerifiers();
   }
 
+  // batch: the final equations of all of the chunks are checked together
+  // as one multiexp. If the batch fails, every chunk is verified alone.
   bool Verify(h256_t const& rom_seed, std::function<Fr(int64_t)> get_w,
-              std::vector<Proof> const& proofs, VerifyOutput& output) {
+              std::vector<Proof> const& proofs, VerifyOutput& output,
+              bool batch = false) {
     Tick tick(__FUNCTION__);
     if (proofs.size() != verifiers_.size()) return false;
     auto size = (int64_t)verifiers_.size();
     std::vector<VerifyOutput> outputs(size);
     std::vector<int64_t> rets(size);
+    std::vector<EquationBatch> batches(batch ? size : 0);
 
-    auto parallel_f = [this, &rets, &get_w, &rom_seed, &proofs,
-                       &outputs](int64_t i) /*mutable*/ {
+    auto parallel_f = [this, &rets, &get_w, &rom_seed, &proofs, &outputs,
+                       &batches](int64_t i) /*mutable*/ {
       auto const& item = items_[i];
       auto this_get_w = [&item, &get_w](int64_t j) {
         return get_w(j + item.first);
       };
       rets[i] = verifiers_[i]->Verify(rom_seed, std::move(this_get_w),
-                                      proofs[i], outputs[i]);
+                                      proofs[i], outputs[i],
+                                      batches.empty() ? nullptr : &batches[i]);
       verifiers_[i].reset();
     };
     parallel::For(size, parallel_f);
@@ -308,6 +372,15 @@ class LargeVerifier {
     if (std::any_of(rets.begin(), rets.end(), [](int64_t r) { return !r; }))
       return false;
 
+    if (batch) {
+      for (int64_t i = 1; i < size; ++i) batches[0].Merge(batches[i]);
+      if (!batches[0].Check()) {
+        std::cout << __FUNCTION__ << ": batch failed, verify every chunk\n";
+        BuildVerifiers();
+        return Verify(rom_seed, std::move(get_w), proofs, output, false);
+      }
+    }
+
     MergeOutputs(output, outputs);
 
     com_vw_ = parallel::Accumulate(
@@ -319,6 +392,23 @@ class LargeVerifier {
 
   G1 const& com_vw() const { return com_vw_; }
 
+ private:
+  void BuildVerifiers() {
+    auto pair_size = [](std::pair<int64_t, int64_t> const& p) {
+      return p.second - p.first;
+    };
+
+    verifiers_.resize(items_.size());
+    auto parallel_f = [this, &pair_size](int64_t i) mutable {
+      auto const& item = items_[i];
+      PublicInput this_input(pair_size(item), [&item, this](int64_t j) {
+        return public_input_.get_p(item.first + j);
+      });
+      verifiers_[i].reset(new Verifier(this_input));
+    };
+    parallel::For((int64_t)verifiers_.size(), parallel_f);
+  }
+
  private:
   PublicInput public_input_;
   std::vector<std::unique_ptr<Verifier>> verifiers_;
@@ -50,4 +50,42 @@ inline Fr Mimc5Enc(Fr const& plain, Fr const& key) {
   }
   return enc + key;
 }
+
+// out[i] = Mimc5Enc(plain[i], key), out can be plain. Several independent
+// encryptions are interleaved so that their multiplications pipeline, and
+// key + const is computed once for all of the items.
+inline void Mimc5EncBatch(Fr const* plain, Fr const& key, Fr* out, int64_t n) {
+  static constexpr int64_t kLanes = 4;
+  auto const& kMimc5Const = Mimc5Const();
+  std::vector<Fr> round_const(kMimc5Const.size());
+  for (size_t r = 0; r < kMimc5Const.size(); ++r) {
+    round_const[r] = key + kMimc5Const[r];
+  }
+
+  int64_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    Fr x[kLanes];
+    Fr t[kLanes];
+    for (int64_t l = 0; l < kLanes; ++l) x[l] = plain[i + l];
+    for (auto const& c : round_const) {
+      for (int64_t l = 0; l < kLanes; ++l) x[l] += c;
+      for (int64_t l = 0; l < kLanes; ++l) Fr::sqr(t[l], x[l]);
+      for (int64_t l = 0; l < kLanes; ++l) Fr::sqr(t[l], t[l]);
+      for (int64_t l = 0; l < kLanes; ++l) Fr::mul(x[l], t[l], x[l]);
+    }
+    for (int64_t l = 0; l < kLanes; ++l) out[i + l] = x[l] + key;
+  }
+
+  for (; i < n; ++i) {
+    Fr x = plain[i];
+    Fr t;
+    for (auto const& c : round_const) {
+      x += c;
+      Fr::sqr(t, x);
+      Fr::sqr(t, t);
+      Fr::mul(x, t, x);
+    }
+    out[i] = x + key;
+  }
+}
 }  // namespace vrs
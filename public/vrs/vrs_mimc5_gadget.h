@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <iostream>
 #include <libsnark/gadgetlib1/gadget.hpp>
 #include <libsnark/gadgetlib1/gadgets/basic_gadgets.hpp>
@@ -94,4 +95,36 @@ class Mimc5Gadget : public libsnark::gadget<Fr> {
   libsnark::pb_variable_array<Fr> rounds_x5_;
 };
 
+// The variables of Mimc5Gadget in the order of full_variable_assignment():
+// plain, key, rounds_x2[], rounds_x4[], rounds_x5[]. The last one is the
+// result.
+inline static const int64_t kMimc5VarNum = 2 + 3 * kMimc5Round;
+
+// Same witness as Mimc5Gadget::Assign() of count rows, without the protoboard.
+// The buffer is variable major: values[j * stride + i] is the variable j of
+// the row i, so every variable of all rows is contiguous.
+inline void Mimc5Witness(Fr const* plains, Fr const& key, int64_t count,
+                         int64_t stride, Fr* values) {
+  auto const& constants = Mimc5Const();
+  Fr* x2 = values + 2 * stride;
+  Fr* x4 = x2 + kMimc5Round * stride;
+  Fr* x5 = x4 + kMimc5Round * stride;
+  std::copy(plains, plains + count, values);
+  std::fill(values + stride, values + stride + count, key);
+  Fr const* data = plains;
+  for (int64_t r = 0; r < kMimc5Round; ++r) {
+    auto offset = r * stride;
+    Fr x1_const = key + constants[r];
+    for (int64_t i = 0; i < count; ++i) {
+      Fr x1 = data[i] + x1_const;
+      Fr::sqr(x2[offset + i], x1);
+      Fr::sqr(x4[offset + i], x2[offset + i]);
+      Fr::mul(x5[offset + i], x4[offset + i], x1);
+    }
+    data = x5 + offset;
+  }
+  Fr* result = x5 + (kMimc5Round - 1) * stride;
+  for (int64_t i = 0; i < count; ++i) result[i] += key;
+}
+
 }  // namespace vrs
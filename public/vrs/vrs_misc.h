@@ -2,12 +2,14 @@
 
 #include <cryptopp/keccak.h>
 
+#include <algorithm>
 #include <boost/endian/conversion.hpp>
 #include <string>
 #include <vector>
 
 #include "ecc.h"
 #include "ecc_pub.h"
+#include "keccak_batch.h"
 #include "pds_pub.h"
 #include "vrs_mimc.h"
 
@@ -40,6 +42,25 @@ inline Fr GeneratePlain(h256_t const& plain_seed, int64_t position) {
   return ret;
 }
 
+// out[i] = GeneratePlain(plain_seed, begin + i)
+inline void GeneratePlain(Fr* out, h256_t const& plain_seed, int64_t begin,
+                          int64_t count) {
+  constexpr size_t kMsgSize = sizeof(h256_t) + sizeof(int64_t);
+  std::vector<uint8_t> msgs(count * kMsgSize);
+  for (int64_t i = 0; i < count; ++i) {
+    uint8_t* p = msgs.data() + i * kMsgSize;
+    auto offset_big = boost::endian::native_to_big(begin + i);
+    memcpy(p, plain_seed.data(), plain_seed.size());
+    memcpy(p + plain_seed.size(), &offset_big, sizeof(offset_big));
+  }
+
+  std::vector<h256_t> plains(count);
+  keccak::Keccak256Batch(msgs.data(), kMsgSize, plains.data(), count);
+  for (int64_t i = 0; i < count; ++i) {
+    out[i] = H256ToFr(plains[i]);
+  }
+}
+
 // Since the plain data is random, we do not need to use cbc mode.
 inline void GenerateV(int64_t offset, Fr const& key, h256_t const& plain_seed,
                       Fr* out) {
@@ -53,6 +74,21 @@ inline Fr GenerateV(int64_t offset, Fr const& key, h256_t const& plain_seed) {
   return ret;
 }
 
+// v[i] = GenerateV(begin + i, key, plain_seed), and plain[i] is the plain if
+// plain is not null. Block by block, the plains are encrypted while they are
+// still in the cache.
+inline void GenerateV(Fr* v, Fr* plain, Fr const& key,
+                      h256_t const& plain_seed, int64_t begin, int64_t count) {
+  static constexpr int64_t kBlock = 256;
+  Fr block[kBlock];
+  for (int64_t i = 0; i < count; i += kBlock) {
+    auto size = std::min(kBlock, count - i);
+    Fr* p = plain ? plain + i : block;
+    GeneratePlain(p, plain_seed, begin + i, size);
+    Mimc5EncBatch(p, key, v + i, size);
+  }
+}
+
 inline std::vector<std::pair<int64_t, int64_t>> SplitLargeTask(int64_t count) {
   std::vector<std::pair<int64_t, int64_t>> items((count + kMaxUnitPerZkp - 1) /
                                                  kMaxUnitPerZkp);
@@ -4,6 +4,7 @@
 #include "vrs_mimc.h"
 #include "vrs_mimc5_gadget.h"
 #include "vrs_misc.h"
+#include "vrs_r1cs.h"
 #include "vrs_types.h"
 
 // Verifiable Random Sequence Prover
@@ -21,10 +22,7 @@ class Prover {
     auto count = public_input_.count;
     pds_sigma_g_ = ComputePdsSigmaG(count);
     v_.resize(count);
-    values_.resize(count);
-    pb_.reset(new libsnark::protoboard<Fr>);
-    gadget_.reset(new Mimc5Gadget(*pb_));
-    pb_->set_input_sizes(primary_input_size_);  // var_plain is public statement
+    values_.resize(num_variables() * count);
 
     assert(cached_var_coms_.size() == cached_var_coms_r_.size());
   }
@@ -38,6 +36,13 @@ class Prover {
 #endif
   }
 
+  // the peak bytes of a prover of count rows: the witness and the sec43 input
+  static int64_t EstimateMemory(int64_t count) {
+    auto const& r1cs = Mimc5R1cs();
+    return (r1cs.num_variables + 3 * r1cs.num_constraints()) * count *
+           (int64_t)sizeof(Fr);
+  }
+
   PublicInput const& public_input() const { return public_input_; }
 
   SecretInput const& secret_input() const { return secret_input_; }
@@ -52,14 +57,25 @@ class Prover {
   // the v (too large)
   void Evaluate() {
     // Tick tick(__FUNCTION__);
+    static constexpr int64_t kChunk = 1024;
     auto count = public_input_.count;
+    std::vector<Fr> plains(count);
     for (int64_t i = 0; i < count; ++i) {
-      auto plain = public_input_.get_p(i);
-      gadget_->Assign(plain, secret_input_.key);
-      assert(pb_->is_satisfied());
-      v_[i] = pb_->val(gadget_->result());
-      values_[i] = pb_->full_variable_assignment();
+      plains[i] = public_input_.get_p(i);
     }
+
+    auto chunk_count = (count + kChunk - 1) / kChunk;
+    auto parallel_f = [this, count, &plains](int64_t c) {
+      auto begin = c * kChunk;
+      auto end = std::min(begin + kChunk, count);
+      Mimc5Witness(plains.data() + begin, secret_input_.key, end - begin,
+                   count, values_.data() + begin);
+    };
+    parallel::For(chunk_count, parallel_f);
+
+    auto const* result = values_.data() + (num_variables() - 1) * count;
+    std::copy(result, result + count, v_.begin());
+    DebugCheckValues();
   }
 
   void Prove(h256_t const& rom_seed, std::function<Fr(int64_t)> get_w,
@@ -84,9 +100,26 @@ class Prover {
   }
 
  private:
-  int64_t num_variables() const { return (int64_t)pb_->num_variables(); }
+  int64_t num_variables() const { return r1cs_.num_variables; }
 
-  int64_t num_constraints() const { return (int64_t)pb_->num_constraints(); }
+  int64_t num_constraints() const { return r1cs_.num_constraints(); }
+
+  void DebugCheckValues() {
+#ifdef _DEBUG
+    libsnark::protoboard<Fr> pb;
+    Mimc5Gadget gadget(pb);
+    pb.set_input_sizes(primary_input_size_);
+    auto count = public_input_.count;
+    for (int64_t i = 0; i < count; i += std::max<int64_t>(1, count / 8)) {
+      gadget.Assign(values_[i], secret_input_.key);
+      assert(pb.is_satisfied());
+      auto const& check_values = pb.full_variable_assignment();
+      for (int64_t j = 0; j < num_variables(); ++j) {
+        assert(check_values[j] == values_[j * count + i]);
+      }
+    }
+#endif
+  }
 
   void BuildVarComs() {
     if ((int64_t)cached_var_coms_.size() == num_variables()) {
@@ -110,12 +143,8 @@ class Prover {
     var_coms_r_.resize(var_coms_.size());
 
     auto parallel_f = [this, count](int64_t i) mutable {
-      std::vector<Fr> data(count);
       auto& var_com = var_coms_[i];
       auto& var_com_r = var_coms_r_[i];
-      for (int64_t j = 0; j < count; ++j) {
-        data[j] = values_[j][i];
-      }
       if (i < primary_input_size_) {
         var_com_r = FrZero();
       } else if (i == primary_input_size_) {
@@ -123,7 +152,7 @@ class Prover {
       } else {
         var_com_r = FrRand();
       }
-      var_com = ComputeCommitment(data, var_com_r);
+      var_com = ComputeCommitment(values_.data() + i * count, count, var_com_r);
     };
     parallel::For((int64_t)var_coms_.size(), parallel_f);
   }
@@ -141,20 +170,16 @@ class Prover {
     for (auto& i : z) i.resize(n);
     // std::cout << "sec43: " << m << "*" << n << "\n";
 
-    auto constraint_system = pb_->get_constraint_system();
-    auto const& constraints = constraint_system.constraints;
-
-    auto parallel_f = [this, &constraints, &x, &y, &z, &m](int64_t j) mutable {
-      auto const& values = values_[j];
-      for (int64_t i = 0; i < m; ++i) {
-        auto const& constraint = constraints[i];
-        x[i][j] = constraint.a.evaluate(values);
-        y[i][j] = constraint.b.evaluate(values);
-        z[i][j] = constraint.c.evaluate(values);
+    auto parallel_f = [this, &x, &y, &z, n](int64_t i) mutable {
+      auto const* values = values_.data();
+      r1cs_.a.Evaluate(i, values, n, x[i].data());
+      r1cs_.b.Evaluate(i, values, n, y[i].data());
+      r1cs_.c.Evaluate(i, values, n, z[i].data());
+      for (int64_t j = 0; j < n; ++j) {
         assert(z[i][j] == x[i][j] * y[i][j]);
       }
     };
-    parallel::For(n, parallel_f);
+    parallel::For(m, parallel_f);
 
     // now we do not need values_
     values_.clear();
@@ -169,51 +194,26 @@ class Prover {
     // Tick tick(__FUNCTION__);
     auto m = num_constraints();
     com_pub.a.resize(m);
-    G1Zero(com_pub.a);
     com_pub.b.resize(m);
-    G1Zero(com_pub.b);
     com_pub.c.resize(m);
-    G1Zero(com_pub.c);
     com_sec.r.resize(m);
-    FrZero(com_sec.r);
     com_sec.s.resize(m);
-    FrZero(com_sec.s);
     com_sec.t.resize(m);
-    FrZero(com_sec.t);
 
-    auto constraint_system = pb_->get_constraint_system();
-    auto const& constraints = constraint_system.constraints;
-
-    auto parallel_f = [this, &com_pub, &com_sec,
-                       &constraints](int64_t i) mutable {
-      auto& com_pub_a = com_pub.a[i];
-      auto& com_pub_b = com_pub.b[i];
-      auto& com_pub_c = com_pub.c[i];
-      auto& com_sec_r = com_sec.r[i];
-      auto& com_sec_s = com_sec.s[i];
-      auto& com_sec_t = com_sec.t[i];
-      auto const& constraint = constraints[i];
-      BuildHpCom(constraint.a, com_pub_a, com_sec_r, pds_sigma_g_);
-      BuildHpCom(constraint.b, com_pub_b, com_sec_s, pds_sigma_g_);
-      BuildHpCom(constraint.c, com_pub_c, com_sec_t, pds_sigma_g_);
+    // com(<A,X>), com(<B,X>) and com(<C,X>)
+    auto parallel_f = [this, &com_pub, &com_sec](int64_t i) mutable {
+      auto const* var_coms = var_coms_.data();
+      auto const* var_coms_r = var_coms_r_.data();
+      com_pub.a[i] = r1cs_.a.Combine(i, pds_sigma_g_, var_coms);
+      com_pub.b[i] = r1cs_.b.Combine(i, pds_sigma_g_, var_coms);
+      com_pub.c[i] = r1cs_.c.Combine(i, pds_sigma_g_, var_coms);
+      com_sec.r[i] = r1cs_.a.Combine(i, var_coms_r);
+      com_sec.s[i] = r1cs_.b.Combine(i, var_coms_r);
+      com_sec.t[i] = r1cs_.c.Combine(i, var_coms_r);
     };
     parallel::For(m, parallel_f);
   }
 
-  // com(<A,X>) or com(<B,X>) or com(<C,X>)
-  void BuildHpCom(libsnark::linear_combination<Fr> const& lc, G1& com_pub,
-                  Fr& com_sec, G1 const& sigma_g) {
-    // Tick tick(__FUNCTION__);
-    for (auto const& term : lc.terms) {
-      if (term.index == 0) {
-        com_pub += sigma_g * term.coeff;
-      } else {
-        com_pub += var_coms_[term.index - 1] * term.coeff;
-        com_sec += var_coms_r_[term.index - 1] * term.coeff;
-      }
-    }
-  }
-
   void DebugCheckHpCom(groth09::sec43::ProverInput const& input,
                        groth09::sec43::CommitmentPub const& com_pub,
                        groth09::sec43::CommitmentSec const& com_sec) {
@@ -256,9 +256,6 @@ class Prover {
     BuildHpCom(com_pub, com_sec);
     DebugCheckHpCom(input, com_pub, com_sec);
 
-    gadget_.reset();
-    pb_.reset();
-
     groth09::sec43::AlignData(input, com_pub, com_sec);
     groth09::sec43::RomProve(rom_proof, seed, std::move(input),
                              std::move(com_pub), std::move(com_sec));
@@ -291,9 +288,8 @@ class Prover {
   SecretInput secret_input_;
   std::vector<G1> cached_var_coms_;
   std::vector<Fr> cached_var_coms_r_;
-  std::unique_ptr<libsnark::protoboard<Fr>> pb_;
-  std::unique_ptr<Mimc5Gadget> gadget_;
-  std::vector<std::vector<Fr>> values_;
+  SparseR1cs const& r1cs_ = Mimc5R1cs();
+  std::vector<Fr> values_;  // values_[j * count + i]: variable j of row i
   std::vector<G1> var_coms_;
   std::vector<Fr> var_coms_r_;
   std::vector<Fr> v_;
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "../multiexp.h"
+#include "vrs_mimc5_gadget.h"
+
+namespace vrs {
+
+// One of the A, B, C matrices of a libsnark r1cs, flattened into compressed
+// rows: the terms of the constraint i are [row_begin[i], row_begin[i+1]).
+// var 0 is the constant one and var k is the (k-1)-th variable.
+struct SparseMatrix {
+  std::vector<int64_t> row_begin;
+  std::vector<int64_t> var;
+  std::vector<Fr> coeff;
+
+  int64_t rows() const { return (int64_t)row_begin.size() - 1; }
+
+  void Append(libsnark::linear_combination<Fr> const& lc) {
+    if (row_begin.empty()) row_begin.push_back(0);
+    for (auto const& term : lc.terms) {
+      var.push_back((int64_t)term.index);
+      coeff.push_back(term.coeff);
+    }
+    row_begin.push_back((int64_t)var.size());
+  }
+
+  // out[j] = <row i, the variables of the witness row j>, values is variable
+  // major: values[k * n + j] is the variable k of the witness row j
+  void Evaluate(int64_t i, Fr const* values, int64_t n, Fr* out) const {
+    FrZero(out, n);
+    for (auto t = row_begin[i]; t < row_begin[i + 1]; ++t) {
+      auto const& c = coeff[t];
+      if (var[t] == 0) {
+        for (int64_t j = 0; j < n; ++j) out[j] += c;
+        continue;
+      }
+      auto const* column = values + (var[t] - 1) * n;
+      // the coeffs are almost 1 or -1, avoid the multiplication
+      if (c == FrOne()) {
+        for (int64_t j = 0; j < n; ++j) out[j] += column[j];
+      } else if (c == -FrOne()) {
+        for (int64_t j = 0; j < n; ++j) out[j] -= column[j];
+      } else {
+        for (int64_t j = 0; j < n; ++j) out[j] += column[j] * c;
+      }
+    }
+  }
+
+  // sum(coeff * com), com is one for var 0 and var_coms[var - 1] for others
+  G1 Combine(int64_t i, G1 const& one, G1 const* var_coms) const {
+    G1 ret = G1Zero();
+    std::vector<int64_t> terms;  // the terms need the multiexp
+    for (auto t = row_begin[i]; t < row_begin[i + 1]; ++t) {
+      auto const& com = var[t] ? var_coms[var[t] - 1] : one;
+      if (coeff[t] == FrOne()) {
+        ret += com;
+      } else if (coeff[t] == -FrOne()) {
+        ret -= com;
+      } else {
+        terms.push_back(t);
+      }
+    }
+    auto get_g = [this, &terms, &one, var_coms](int64_t k) -> G1 const& {
+      auto v = var[terms[k]];
+      return v ? var_coms[v - 1] : one;
+    };
+    auto get_f = [this, &terms](int64_t k) -> Fr const& {
+      return coeff[terms[k]];
+    };
+    return ret + MultiExpBdlo12Inner<G1>(get_g, get_f, terms.size());
+  }
+
+  // sum(coeff * r) of the variables, the constant one has no randomness
+  Fr Combine(int64_t i, Fr const* var_rs) const {
+    Fr ret = FrZero();
+    for (auto t = row_begin[i]; t < row_begin[i + 1]; ++t) {
+      if (var[t]) ret += var_rs[var[t] - 1] * coeff[t];
+    }
+    return ret;
+  }
+};
+
+struct SparseR1cs {
+  int64_t num_variables = 0;
+  SparseMatrix a;
+  SparseMatrix b;
+  SparseMatrix c;
+
+  int64_t num_constraints() const { return a.rows(); }
+};
+
+inline SparseR1cs CompileR1cs(libsnark::protoboard<Fr> const& pb) {
+  SparseR1cs ret;
+  ret.num_variables = (int64_t)pb.num_variables();
+  auto constraint_system = pb.get_constraint_system();
+  for (auto const& constraint : constraint_system.constraints) {
+    ret.a.Append(constraint.a);
+    ret.b.Append(constraint.b);
+    ret.c.Append(constraint.c);
+  }
+  return ret;
+}
+
+// The r1cs of Mimc5Gadget, compiled once.
+inline SparseR1cs const& Mimc5R1cs() {
+  static const SparseR1cs instance = []() {
+    libsnark::protoboard<Fr> pb;
+    Mimc5Gadget gadget(pb);
+    pb.set_input_sizes(1);  // var_plain is public statement
+    auto ret = CompileR1cs(pb);
+    assert(ret.num_variables == kMimc5VarNum);
+    return ret;
+  }();
+  return instance;
+}
+
+}  // namespace vrs
@@ -3,6 +3,7 @@
 #include "vrs_mimc5_gadget.h"
 #include "vrs_misc.h"
 #include "vrs_prover.h"
+#include "vrs_r1cs.h"
 #include "vrs_types.h"
 
 // Verifiable Random Sequence Verifier
@@ -13,14 +14,20 @@ class Verifier {
  public:
   Verifier(PublicInput const& public_input) : public_input_(public_input) {
     pds_sigma_g_ = ComputePdsSigmaG(public_input_.count);
-    Evaluate();
   }
 
+  // if batch is not null the final equations are added into it, they must be
+  // checked by batch->Check()
   bool Verify(h256_t const& rom_seed, std::function<Fr(int64_t)> get_w,
-              Proof const& proof, VerifyOutput& output) {
+              Proof const& proof, VerifyOutput& output,
+              EquationBatch* batch = nullptr) {
     // Tick tick(__FUNCTION__);
     using groth09::details::ComputeCommitment;
     auto count = public_input_.count;
+    if ((int64_t)proof.var_coms.size() != r1cs_.num_variables) {
+      assert(false);
+      return false;
+    }
 
     auto seed = rom_seed;
     CryptoPP::Keccak_256 hash;
@@ -31,30 +38,37 @@ class Verifier {
     std::array<parallel::Task, 3> tasks;
     // check com_plain
     bool ret_com_plain = false;
-    tasks[0] = [this, &proof, &ret_com_plain, count]() mutable {
+    tasks[0] = [this, &proof, &ret_com_plain, count, batch]() mutable {
       G1 const& com_plain = proof.var_coms[0];
       Fr com_plain_r = FrZero();
       std::vector<Fr> data(count);
       for (int64_t i = 0; i < count; ++i) {
         data[i] = public_input_.get_p(i);
       }
+      if (batch) {
+        batch->Add({{com_plain, FrOne()}}, data, com_plain_r);
+        ret_com_plain = true;
+        return;
+      }
       auto check_value = ComputeCommitment(data, com_plain_r);
       ret_com_plain = check_value == com_plain;
     };
 
     // check hadamard product
     bool ret_hp = false;
-    tasks[1] = [this, &proof, &ret_hp, &seed]() mutable {
+    tasks[1] = [this, &proof, &ret_hp, &seed, batch]() mutable {
       groth09::sec43::CommitmentPub com_pub_hp;
       BuildHpCom(proof, com_pub_hp);
       com_pub_hp.Align();
       groth09::sec43::VerifierInput input_hp(com_pub_hp);
-      ret_hp = groth09::sec43::RomVerify(proof.proof_hp, seed, input_hp);
+      ret_hp =
+          groth09::sec43::RomVerify(proof.proof_hp, seed, input_hp, batch);
     };
 
     // check inner product
     bool ret_ip = false;
-    tasks[2] = [this, &proof, &ret_ip, count, &get_w, &seed]() mutable {
+    tasks[2] = [this, &proof, &ret_ip, count, &get_w, &seed,
+                batch]() mutable {
       std::vector<Fr> input_w(count);
       for (int64_t i = 0; i < (int64_t)input_w.size(); ++i) {
         input_w[i] = get_w(i);
@@ -62,7 +76,7 @@ class Verifier {
       hyrax::a2::CommitmentPub com_pub_ip;
       BuildIpCom(proof, com_pub_ip);
       hyrax::a2::VerifierInput input_ip(input_w, com_pub_ip);
-      ret_ip = hyrax::a2::RomVerify(proof.proof_ip, seed, input_ip);
+      ret_ip = hyrax::a2::RomVerify(proof.proof_ip, seed, input_ip, batch);
     };
 
     parallel::Invoke(tasks);
@@ -81,65 +95,33 @@ class Verifier {
   }
 
  private:
-  int64_t num_variables() const { return (int64_t)pb_.num_variables(); }
-
-  int64_t num_constraints() const { return (int64_t)pb_.num_constraints(); }
-
-  void Evaluate() {
-    // Tick tick(__FUNCTION__);
-    gadget_.reset(new Mimc5Gadget(pb_));
-    pb_.set_input_sizes(primary_input_size_);  // var_plain is public statement
-  }
+  int64_t num_constraints() const { return r1cs_.num_constraints(); }
 
   void BuildIpCom(Proof const& proof, hyrax::a2::CommitmentPub& com_pub) {
     com_pub.xi = proof.var_coms.back();
     com_pub.tau = proof.com_vw;
   }
 
+  // com(<A,X>), com(<B,X>) and com(<C,X>)
   void BuildHpCom(Proof const& proof, groth09::sec43::CommitmentPub& com_pub) {
     // Tick tick(__FUNCTION__);
     auto m = num_constraints();
     com_pub.a.resize(m);
-    G1Zero(com_pub.a);
     com_pub.b.resize(m);
-    G1Zero(com_pub.b);
     com_pub.c.resize(m);
-    G1Zero(com_pub.c);
-
-    auto constraint_system = pb_.get_constraint_system();
-    auto const& constraints = constraint_system.constraints;
-
-    auto parallel_f = [this, &com_pub, &constraints,
-                       &proof](int64_t i) mutable {
-      auto& com_pub_a = com_pub.a[i];
-      auto& com_pub_b = com_pub.b[i];
-      auto& com_pub_c = com_pub.c[i];
-      auto const& constraint = constraints[i];
-      BuildHpCom(constraint.a, com_pub_a, pds_sigma_g_, proof);
-      BuildHpCom(constraint.b, com_pub_b, pds_sigma_g_, proof);
-      BuildHpCom(constraint.c, com_pub_c, pds_sigma_g_, proof);
+
+    auto const* var_coms = proof.var_coms.data();
+    auto parallel_f = [this, &com_pub, var_coms](int64_t i) mutable {
+      com_pub.a[i] = r1cs_.a.Combine(i, pds_sigma_g_, var_coms);
+      com_pub.b[i] = r1cs_.b.Combine(i, pds_sigma_g_, var_coms);
+      com_pub.c[i] = r1cs_.c.Combine(i, pds_sigma_g_, var_coms);
     };
     parallel::For(m, parallel_f);
   }
 
-  // com(<A,X>) or com(<B,X>) or com(<C,X>)
-  void BuildHpCom(libsnark::linear_combination<Fr> const& lc, G1& com_pub,
-                  G1 const& sigma_g, Proof const& proof) {
-    // Tick tick(__FUNCTION__);
-    for (auto const& term : lc.terms) {
-      if (term.index == 0) {
-        com_pub += sigma_g * term.coeff;
-      } else {
-        com_pub += proof.var_coms[term.index - 1] * term.coeff;
-      }
-    }
-  }
-
  private:
-  int64_t const primary_input_size_ = 1;
   PublicInput public_input_;
-  libsnark::protoboard<Fr> pb_;
-  std::shared_ptr<Mimc5Gadget> gadget_;
+  SparseR1cs const& r1cs_ = Mimc5R1cs();
   G1 pds_sigma_g_;
 };
 
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "public.h"
+#include "vrs/vrs.h"
+
+// The cache files of one size class in the cache dir.
+struct PoolClassStats {
+  int64_t target = 0;
+  int64_t ready = 0;   // can be claimed
+  int64_t in_use = 0;  // claimed by a swap
+  int64_t created = 0;
+};
+
+// Keeps a target number of ready cache files for every size class, the
+// exhausted files are regenerated. Every round also recovers the claims of
+// the dead processes and syncs the cache index with the dir. After every
+// change the stats are written into cache_dir/pool_stats.json.
+class CachePool {
+ public:
+  CachePool(std::string cache_dir, std::map<int64_t, int64_t> targets)
+      : cache_dir_(std::move(cache_dir)) {
+    for (auto const& i : targets) stats_[i.first].target = i.second;
+  }
+
+  // generation competes with the proving of pod_core for the cores, call it
+  // before the task pool starts its threads
+  static void LowerPriority() {
+#ifndef _WIN32
+    if (setpriority(PRIO_PROCESS, 0, 19)) {
+      std::cerr << "setpriority failed\n";
+    }
+#endif
+  }
+
+  // count the files of every size class in the cache index, the classes
+  // without target are counted too
+  static bool Scan(std::string const& cache_dir,
+                   std::map<int64_t, PoolClassStats>& stats) {
+    for (auto& i : stats) i.second.ready = i.second.in_use = 0;
+    std::map<int64_t, std::pair<int64_t, int64_t>> store_stats;
+    if (!vrs::CacheStore(cache_dir).GetStats(store_stats)) return false;
+    for (auto const& i : store_stats) {
+      auto& class_stats = stats[i.first];
+      class_stats.ready = i.second.first;
+      class_stats.in_use = i.second.second;
+    }
+    return true;
+  }
+
+  // fill the classes up to their targets
+  bool RunOnce() {
+    vrs::CacheStore store(cache_dir_);
+    recovered_ += store.Recover();
+    if (!store.Rebuild()) return false;
+    if (!Scan(cache_dir_, stats_)) return false;
+    SaveStats();
+
+    for (auto& i : stats_) {
+      auto count = i.first;
+      auto& class_stats = i.second;
+      while (class_stats.ready < class_stats.target) {
+        auto cache = vrs::CreateCache(count);
+        std::string cache_file;
+        if (!vrs::SaveCache(cache_dir_, cache, cache_file)) {
+          std::cerr << "save cache failed: " << cache_file << "\n";
+          return false;
+        }
+        ++class_stats.ready;
+        ++class_stats.created;
+        SaveStats();
+      }
+    }
+    return true;
+  }
+
+  // never returns
+  void Run(int64_t interval_seconds) {
+    for (;;) {
+      if (!RunOnce()) std::cerr << "pool round failed\n";
+      std::this_thread::sleep_for(std::chrono::seconds(interval_seconds));
+    }
+  }
+
+  std::map<int64_t, PoolClassStats> const& stats() const { return stats_; }
+
+  static void PrintStats(std::map<int64_t, PoolClassStats> const& stats) {
+    for (auto const& i : stats) {
+      auto const& s = i.second;
+      std::cout << "count: " << i.first << ", target: " << s.target
+                << ", ready: " << s.ready << ", using: " << s.in_use
+                << ", created: " << s.created << "\n";
+    }
+  }
+
+ private:
+  // write a temp file and rename it, the readers never see half of it
+  void SaveStats() const {
+    try {
+      pt::ptree tree;
+      tree.put("time", std::time(nullptr));
+      tree.put("recovered", recovered_);
+      pt::ptree classes_node;
+      for (auto const& i : stats_) {
+        auto const& s = i.second;
+        pt::ptree node;
+        node.put("count", i.first);
+        node.put("target", s.target);
+        node.put("ready", s.ready);
+        node.put("using", s.in_use);
+        node.put("created", s.created);
+        classes_node.push_back(std::make_pair("", node));
+      }
+      tree.add_child("classes", classes_node);
+
+      std::string file = cache_dir_ + "/pool_stats.json";
+      std::string temp_file = file + ".tmp";
+      pt::write_json(temp_file, tree);
+      fs::rename(temp_file, file);
+    } catch (std::exception& e) {
+      std::cerr << __FUNCTION__ << ": " << e.what() << "\n";
+    }
+  }
+
+  std::string const cache_dir_;
+  std::map<int64_t, PoolClassStats> stats_;
+  int64_t recovered_ = 0;  // the claims of the dead processes
+};
@@ -1,7 +1,26 @@
+#include "cache_pool.h"
 #include "ecc.h"
 #include "public.h"
 #include "vrs/vrs.h"
 
+// "count:num" to targets[count] = num
+bool ParsePoolTargets(std::vector<std::string> const& items,
+                      std::map<int64_t, int64_t>& targets) {
+  for (auto const& item : items) {
+    auto pos = item.find(':');
+    if (pos == std::string::npos) return false;
+    try {
+      auto count = std::stoll(item.substr(0, pos));
+      auto num = std::stoll(item.substr(pos + 1));
+      if (count <= 1 || num < 0) return false;
+      targets[count] = num;
+    } catch (std::exception&) {
+      return false;
+    }
+  }
+  return !targets.empty();
+}
+
 bool InitAll(std::string const& data_dir) {
   InitEcc();
 
@@ -25,6 +44,11 @@ int main(int argc, char** argv) {
   std::string data_dir;
   uint64_t count;
   uint32_t thread_num = 0;
+  std::vector<std::string> pool_items;
+  std::map<int64_t, int64_t> pool_targets;
+  int64_t pool_interval = 0;
+  bool pool_stats = false;
+  std::string audit_file;
 
   try {
     po::options_description options("command line options");
@@ -34,7 +58,16 @@ int main(int argc, char** argv) {
         "count,c", po::value<uint64_t>(&count)->default_value(2),
         "Provide the count, must >1, should be (n+1)*s or multiple 32k")(
         "thread_num", po::value<uint32_t>(&thread_num)->default_value(0),
-        "Provide the number of the parallel thread, 1: disable, 0: default.");
+        "Provide the number of the parallel thread, 1: disable, 0: default.")(
+        "pool", po::value<std::vector<std::string>>(&pool_items)->multitoken(),
+        "Run as a pool daemon, keep num ready cache files of every count, "
+        "such as: --pool 32768:4 1048576:2")(
+        "pool_interval",
+        po::value<int64_t>(&pool_interval)->default_value(10),
+        "Provide the seconds between two pool rounds")(
+        "pool_stats", "Print the stats of the cache files and exit")(
+        "audit", po::value<std::string>(&audit_file),
+        "Check the mac and recompute all of the commitments of a cache file");
 
     boost::program_options::variables_map vmap;
 
@@ -51,6 +84,13 @@ int main(int argc, char** argv) {
       std::cout << options << std::endl;
       return -1;
     }
+
+    if (!pool_items.empty() && !ParsePoolTargets(pool_items, pool_targets)) {
+      std::cout << "invalid pool: count:num, count must >1\n";
+      return -1;
+    }
+
+    pool_stats = vmap.count("pool_stats") != 0;
   } catch (std::exception& e) {
     std::cout << "Unknown parameters.\n"
               << e.what() << "\n"
@@ -58,6 +98,9 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  // before any thread is started, the threads inherit the priority
+  if (!pool_targets.empty()) CachePool::LowerPriority();
+
 #ifdef USE_TBB
   int tbb_thread_num =
       thread_num ? (int)thread_num : tbb::task_scheduler_init::automatic;
@@ -72,6 +115,25 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (!audit_file.empty()) {
+    h256_t mac_key;
+    vrs::CacheFile file;
+    auto dir = fs::absolute(audit_file).parent_path().string();
+    // read only, an audit never creates the key
+    if (!vrs::ReadCacheMacKey(dir, mac_key)) {
+      std::cout << "No mac key in: " << dir << "\n";
+      return -1;
+    }
+    if (!file.Open(audit_file, mac_key)) {
+      std::cout << "Invalid cache file or mac: " << audit_file << "\n";
+      return -1;
+    }
+    bool ret = vrs::CheckCacheFile(file, 0);
+    std::cout << (ret ? "Audit passed: " : "Audit failed: ") << audit_file
+              << "\n";
+    return ret ? 0 : -1;
+  }
+
   std::string cache_dir = data_dir + "/vrs_cache";
   fs::create_directories(cache_dir);
   if (!fs::is_directory(cache_dir)) {
@@ -79,6 +141,19 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (pool_stats) {
+    std::map<int64_t, PoolClassStats> stats;
+    if (!CachePool::Scan(cache_dir, stats)) return -1;
+    CachePool::PrintStats(stats);
+    return 0;
+  }
+
+  if (!pool_targets.empty()) {
+    CachePool pool(cache_dir, std::move(pool_targets));
+    pool.Run(std::max<int64_t>(1, pool_interval));
+    return 0;
+  }
+
   auto cache = vrs::CreateCache(count);
 
   std::string cache_file;